@@ -10,6 +10,7 @@
 
 #include "./Packet/CPacket.h"
 #include "./VLESS/CVLESS.h"
+#include "./VLESS/CXUDP.h"
 #include "./lwip/lwip_bridge.h"
 #include "./Crypto/blake3.h"
 
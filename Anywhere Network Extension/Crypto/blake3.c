@@ -264,6 +264,19 @@ compress_subtree_to_parent_node(const uint8_t *input, size_t input_len,
   size_t num_cvs = blake3_compress_subtree_wide(input, input_len, key,
                                                 chunk_counter, flags, cv_array, use_tbb);
   assert(num_cvs <= MAX_SIMD_DEGREE_OR_2);
+#if MAX_SIMD_DEGREE_OR_2 > 2
+  // With SIMD and enough input, compress_subtree_wide() returns more than 2
+  // chaining values. Condense them into 2 by forming parent nodes repeatedly.
+  uint8_t out_array[MAX_SIMD_DEGREE_OR_2 * BLAKE3_OUT_LEN / 2];
+  while (num_cvs > 2) {
+    num_cvs =
+        compress_parents_parallel(cv_array, num_cvs, key, flags, out_array);
+    memcpy(cv_array, out_array, num_cvs * BLAKE3_OUT_LEN);
+  }
+#else
+  // num_cvs is always <= 2 here; it is only read by the assert above
+  (void)num_cvs;
+#endif
   memcpy(out, cv_array, 2 * BLAKE3_OUT_LEN);
 }
 
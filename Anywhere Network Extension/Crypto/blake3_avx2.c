@@ -0,0 +1,201 @@
+// AVX2 backend for BLAKE3 (x86-64): hashes eight inputs at once.
+//
+// Built without -mavx2: every function carries a target attribute, and
+// blake3_dispatch.c only calls in here after checking CPUID and XCR0. Single
+// blocks and leftover inputs go to the SSE4.1 backend, which every AVX2 CPU
+// also has.
+
+#include "blake3_impl.h"
+
+#if defined(BLAKE3_USE_X86)
+
+#include <immintrin.h>
+
+#define DEGREE 8
+
+#define AVX2_INLINE INLINE __attribute__((target("avx2")))
+#define AVX2_FN __attribute__((target("avx2")))
+
+AVX2_INLINE __m256i loadu(const uint8_t src[32]) {
+  return _mm256_loadu_si256((const __m256i *)src);
+}
+
+AVX2_INLINE void storeu(__m256i src, uint8_t dest[32]) {
+  _mm256_storeu_si256((__m256i *)dest, src);
+}
+
+AVX2_INLINE __m256i addv(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+AVX2_INLINE __m256i xorv(__m256i a, __m256i b) {
+  return _mm256_xor_si256(a, b);
+}
+
+AVX2_INLINE __m256i set1(uint32_t x) {
+  return _mm256_set1_epi32((int32_t)x);
+}
+
+AVX2_INLINE __m256i rot16(__m256i x) {
+  return _mm256_shuffle_epi8(
+      x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                         13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+AVX2_INLINE __m256i rot12(__m256i x) {
+  return xorv(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 32 - 12));
+}
+
+AVX2_INLINE __m256i rot8(__m256i x) {
+  return _mm256_shuffle_epi8(
+      x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+                         12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+AVX2_INLINE __m256i rot7(__m256i x) {
+  return xorv(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 32 - 7));
+}
+
+AVX2_INLINE void g(__m256i v[16], size_t a, size_t b, size_t c, size_t d,
+                   __m256i x, __m256i y) {
+  v[a] = addv(addv(v[a], v[b]), x);
+  v[d] = rot16(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot12(xorv(v[b], v[c]));
+  v[a] = addv(addv(v[a], v[b]), y);
+  v[d] = rot8(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot7(xorv(v[b], v[c]));
+}
+
+AVX2_INLINE void round_fn(__m256i v[16], const __m256i m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+  g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+  g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+  g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+  g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+  g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+  g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+  g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+AVX2_INLINE void transpose_vecs(__m256i vecs[DEGREE]) {
+  // Interleave 32-bit lanes
+  __m256i ab_0145 = _mm256_unpacklo_epi32(vecs[0], vecs[1]);
+  __m256i ab_2367 = _mm256_unpackhi_epi32(vecs[0], vecs[1]);
+  __m256i cd_0145 = _mm256_unpacklo_epi32(vecs[2], vecs[3]);
+  __m256i cd_2367 = _mm256_unpackhi_epi32(vecs[2], vecs[3]);
+  __m256i ef_0145 = _mm256_unpacklo_epi32(vecs[4], vecs[5]);
+  __m256i ef_2367 = _mm256_unpackhi_epi32(vecs[4], vecs[5]);
+  __m256i gh_0145 = _mm256_unpacklo_epi32(vecs[6], vecs[7]);
+  __m256i gh_2367 = _mm256_unpackhi_epi32(vecs[6], vecs[7]);
+
+  // Interleave 64-bit lanes
+  __m256i abcd_04 = _mm256_unpacklo_epi64(ab_0145, cd_0145);
+  __m256i abcd_15 = _mm256_unpackhi_epi64(ab_0145, cd_0145);
+  __m256i abcd_26 = _mm256_unpacklo_epi64(ab_2367, cd_2367);
+  __m256i abcd_37 = _mm256_unpackhi_epi64(ab_2367, cd_2367);
+  __m256i efgh_04 = _mm256_unpacklo_epi64(ef_0145, gh_0145);
+  __m256i efgh_15 = _mm256_unpackhi_epi64(ef_0145, gh_0145);
+  __m256i efgh_26 = _mm256_unpacklo_epi64(ef_2367, gh_2367);
+  __m256i efgh_37 = _mm256_unpackhi_epi64(ef_2367, gh_2367);
+
+  // Interleave 128-bit halves
+  vecs[0] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x20);
+  vecs[1] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x20);
+  vecs[2] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x20);
+  vecs[3] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x20);
+  vecs[4] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x31);
+  vecs[5] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x31);
+  vecs[6] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x31);
+  vecs[7] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x31);
+}
+
+AVX2_INLINE void transpose_msg_vecs(const uint8_t *const *inputs,
+                                    size_t block_offset, __m256i out[16]) {
+  for (size_t i = 0; i < 2; i++) {
+    for (size_t lane = 0; lane < DEGREE; lane++) {
+      out[8 * i + lane] = loadu(&inputs[lane][block_offset + 32 * i]);
+    }
+    transpose_vecs(&out[8 * i]);
+  }
+}
+
+AVX2_INLINE void load_counters(uint64_t counter, bool increment_counter,
+                               __m256i *out_lo, __m256i *out_hi) {
+  uint32_t lo[DEGREE], hi[DEGREE];
+  for (size_t lane = 0; lane < DEGREE; lane++) {
+    uint64_t c = counter + (increment_counter ? lane : 0);
+    lo[lane] = counter_low(c);
+    hi[lane] = counter_high(c);
+  }
+  *out_lo = loadu((const uint8_t *)lo);
+  *out_hi = loadu((const uint8_t *)hi);
+}
+
+AVX2_INLINE void hash8(const uint8_t *const *inputs, size_t blocks,
+                       const uint32_t key[8], uint64_t counter,
+                       bool increment_counter, uint8_t flags,
+                       uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+  __m256i h_vecs[8];
+  for (size_t i = 0; i < 8; i++) {
+    h_vecs[i] = set1(key[i]);
+  }
+  __m256i counter_low_vec, counter_high_vec;
+  load_counters(counter, increment_counter, &counter_low_vec,
+                &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m256i msg_vecs[16];
+    transpose_msg_vecs(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    __m256i v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],     h_vecs[3],
+        h_vecs[4],       h_vecs[5],        h_vecs[6],     h_vecs[7],
+        set1(IV[0]),     set1(IV[1]),      set1(IV[2]),   set1(IV[3]),
+        counter_low_vec, counter_high_vec, set1(BLAKE3_BLOCK_LEN),
+        set1(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++) {
+      round_fn(v, msg_vecs, r);
+    }
+    for (size_t i = 0; i < 8; i++) {
+      h_vecs[i] = xorv(v[i], v[i + 8]);
+    }
+    block_flags = flags;
+  }
+
+  // Back to one vector per input: h_vecs[i] is input i's chaining value
+  transpose_vecs(h_vecs);
+  for (size_t lane = 0; lane < DEGREE; lane++) {
+    storeu(h_vecs[lane], &out[lane * BLAKE3_OUT_LEN]);
+  }
+}
+
+AVX2_FN
+void blake3_hash_many_avx2(const uint8_t *const *inputs, size_t num_inputs,
+                           size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool increment_counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    hash8(inputs, blocks, key, counter, increment_counter, flags, flags_start,
+          flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+  blake3_hash_many_sse41(inputs, num_inputs, blocks, key, counter,
+                         increment_counter, flags, flags_start, flags_end,
+                         out);
+}
+
+#endif // BLAKE3_USE_X86
@@ -1,20 +1,85 @@
-// Portable-only dispatch for BLAKE3.
-// Routes all calls to the portable (non-SIMD) implementation.
+// Backend dispatch for BLAKE3.
+// Routes each call to the widest SIMD implementation the CPU supports, with
+// the portable implementation as the fallback. x86-64 picks SSE4.1/AVX2 at
+// runtime from CPUID (probed once, then cached); AArch64 always has NEON.
 
 #include "blake3_impl.h"
 
+#if defined(BLAKE3_USE_X86)
+#include <cpuid.h>
+
+enum cpu_feature {
+  SSE41 = 1 << 0,
+  AVX2 = 1 << 1,
+  UNDEFINED = 1 << 30,
+};
+
+static int g_cpu_features = UNDEFINED;
+
+static uint64_t xgetbv(void) {
+  uint32_t eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t)edx << 32) | eax;
+}
+
+static int get_cpu_features(void) {
+  int features = __atomic_load_n(&g_cpu_features, __ATOMIC_RELAXED);
+  if (features != UNDEFINED) {
+    return features;
+  }
+
+  features = 0;
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    if (ecx & bit_SSE4_1) {
+      features |= SSE41;
+    }
+    // AVX2 also needs the OS to save the YMM registers (XCR0 bits 1 and 2)
+    bool avx_usable = (ecx & bit_OSXSAVE) && (ecx & bit_AVX) &&
+                      (xgetbv() & 0x6) == 0x6;
+    if ((features & SSE41) && avx_usable &&
+        __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2)) {
+      features |= AVX2;
+    }
+  }
+
+  __atomic_store_n(&g_cpu_features, features, __ATOMIC_RELAXED);
+  return features;
+}
+#endif
+
 void blake3_compress_in_place(uint32_t cv[8],
                               const uint8_t block[BLAKE3_BLOCK_LEN],
                               uint8_t block_len, uint64_t counter,
                               uint8_t flags) {
+#if defined(BLAKE3_USE_X86)
+  if (get_cpu_features() & SSE41) {
+    blake3_compress_in_place_sse41(cv, block, block_len, counter, flags);
+    return;
+  }
   blake3_compress_in_place_portable(cv, block, block_len, counter, flags);
+#elif defined(BLAKE3_USE_NEON)
+  blake3_compress_in_place_neon(cv, block, block_len, counter, flags);
+#else
+  blake3_compress_in_place_portable(cv, block, block_len, counter, flags);
+#endif
 }
 
 void blake3_compress_xof(const uint32_t cv[8],
                          const uint8_t block[BLAKE3_BLOCK_LEN],
                          uint8_t block_len, uint64_t counter, uint8_t flags,
                          uint8_t out[64]) {
+#if defined(BLAKE3_USE_X86)
+  if (get_cpu_features() & SSE41) {
+    blake3_compress_xof_sse41(cv, block, block_len, counter, flags, out);
+    return;
+  }
+  blake3_compress_xof_portable(cv, block, block_len, counter, flags, out);
+#elif defined(BLAKE3_USE_NEON)
+  blake3_compress_xof_neon(cv, block, block_len, counter, flags, out);
+#else
   blake3_compress_xof_portable(cv, block, block_len, counter, flags, out);
+#endif
 }
 
 void blake3_xof_many(const uint32_t cv[8],
@@ -22,7 +87,7 @@ void blake3_xof_many(const uint32_t cv[8],
                      uint8_t block_len, uint64_t counter, uint8_t flags,
                      uint8_t *out, size_t outblocks) {
   while (outblocks > 0) {
-    blake3_compress_xof_portable(cv, block, block_len, counter, flags, out);
+    blake3_compress_xof(cv, block, block_len, counter, flags, out);
     counter++;
     out += 64;
     outblocks--;
@@ -33,9 +98,47 @@ void blake3_hash_many(const uint8_t *const *inputs, size_t num_inputs,
                       size_t blocks, const uint32_t key[8], uint64_t counter,
                       bool increment_counter, uint8_t flags,
                       uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+#if defined(BLAKE3_USE_X86)
+  const int features = get_cpu_features();
+  if (features & AVX2) {
+    blake3_hash_many_avx2(inputs, num_inputs, blocks, key, counter,
+                          increment_counter, flags, flags_start, flags_end,
+                          out);
+    return;
+  }
+  if (features & SSE41) {
+    blake3_hash_many_sse41(inputs, num_inputs, blocks, key, counter,
+                           increment_counter, flags, flags_start, flags_end,
+                           out);
+    return;
+  }
   blake3_hash_many_portable(inputs, num_inputs, blocks, key, counter,
                             increment_counter, flags, flags_start, flags_end,
                             out);
+#elif defined(BLAKE3_USE_NEON)
+  blake3_hash_many_neon(inputs, num_inputs, blocks, key, counter,
+                        increment_counter, flags, flags_start, flags_end, out);
+#else
+  blake3_hash_many_portable(inputs, num_inputs, blocks, key, counter,
+                            increment_counter, flags, flags_start, flags_end,
+                            out);
+#endif
 }
 
-size_t blake3_simd_degree(void) { return 1; }
+// The number of inputs blake3_hash_many processes in parallel
+size_t blake3_simd_degree(void) {
+#if defined(BLAKE3_USE_X86)
+  const int features = get_cpu_features();
+  if (features & AVX2) {
+    return 8;
+  }
+  if (features & SSE41) {
+    return 4;
+  }
+  return 1;
+#elif defined(BLAKE3_USE_NEON)
+  return 4;
+#else
+  return 1;
+#endif
+}
@@ -32,9 +32,21 @@ enum blake3_flags {
 #define INLINE static inline __attribute__((always_inline))
 #endif
 
-// Portable-only build: force SIMD degree to 1, no platform-specific intrinsics.
+// SIMD backends: SSE4.1/AVX2 on x86-64, picked at runtime from CPUID, and
+// NEON on AArch64, where it is always present. Define BLAKE3_NO_SIMD to build
+// the portable implementation only.
+#if !defined(BLAKE3_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(_M_X64))
+#define BLAKE3_USE_X86 1
+#define MAX_SIMD_DEGREE 8
+#elif !defined(BLAKE3_NO_SIMD) && defined(__aarch64__)
+#define BLAKE3_USE_NEON 1
+#define MAX_SIMD_DEGREE 4
+#else
 #define MAX_SIMD_DEGREE 1
-#define MAX_SIMD_DEGREE_OR_2 2
+#endif
+
+#define MAX_SIMD_DEGREE_OR_2 (MAX_SIMD_DEGREE > 2 ? MAX_SIMD_DEGREE : 2)
 
 static const uint32_t IV[8] = {0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL,
                                0xA54FF53AUL, 0x510E527FUL, 0x9B05688CUL,
@@ -157,7 +169,7 @@ void blake3_compress_xof(const uint32_t cv[8],
 void blake3_xof_many(const uint32_t cv[8],
                      const uint8_t block[BLAKE3_BLOCK_LEN],
                      uint8_t block_len, uint64_t counter, uint8_t flags,
-                     uint8_t out[64], size_t outblocks);
+                     uint8_t *out, size_t outblocks);
 
 void blake3_hash_many(const uint8_t *const *inputs, size_t num_inputs,
                       size_t blocks, const uint32_t key[8], uint64_t counter,
@@ -188,6 +200,43 @@ void blake3_hash_many_portable(const uint8_t *const *inputs, size_t num_inputs,
                                uint8_t flags, uint8_t flags_start,
                                uint8_t flags_end, uint8_t *out);
 
+#if defined(BLAKE3_USE_X86)
+void blake3_compress_in_place_sse41(uint32_t cv[8],
+                                    const uint8_t block[BLAKE3_BLOCK_LEN],
+                                    uint8_t block_len, uint64_t counter,
+                                    uint8_t flags);
+void blake3_compress_xof_sse41(const uint32_t cv[8],
+                               const uint8_t block[BLAKE3_BLOCK_LEN],
+                               uint8_t block_len, uint64_t counter,
+                               uint8_t flags, uint8_t out[64]);
+void blake3_hash_many_sse41(const uint8_t *const *inputs, size_t num_inputs,
+                            size_t blocks, const uint32_t key[8],
+                            uint64_t counter, bool increment_counter,
+                            uint8_t flags, uint8_t flags_start,
+                            uint8_t flags_end, uint8_t *out);
+void blake3_hash_many_avx2(const uint8_t *const *inputs, size_t num_inputs,
+                           size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool increment_counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t *out);
+#endif
+
+#if defined(BLAKE3_USE_NEON)
+void blake3_compress_in_place_neon(uint32_t cv[8],
+                                   const uint8_t block[BLAKE3_BLOCK_LEN],
+                                   uint8_t block_len, uint64_t counter,
+                                   uint8_t flags);
+void blake3_compress_xof_neon(const uint32_t cv[8],
+                              const uint8_t block[BLAKE3_BLOCK_LEN],
+                              uint8_t block_len, uint64_t counter,
+                              uint8_t flags, uint8_t out[64]);
+void blake3_hash_many_neon(const uint8_t *const *inputs, size_t num_inputs,
+                           size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool increment_counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t *out);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,292 @@
+// NEON backend for BLAKE3 (AArch64, where NEON is always present).
+//
+// Covers both single-block compression (one row of the state per vector),
+// which is what short inputs such as XUDP GlobalIDs spend their time in, and
+// hashing four inputs at once for long ones.
+
+#include "blake3_impl.h"
+
+#if defined(BLAKE3_USE_NEON)
+
+#include <arm_neon.h>
+
+#define DEGREE 4
+
+INLINE uint32x4_t loadu(const uint8_t src[16]) {
+  return vreinterpretq_u32_u8(vld1q_u8(src));
+}
+
+INLINE void storeu(uint32x4_t src, uint8_t dest[16]) {
+  vst1q_u8(dest, vreinterpretq_u8_u32(src));
+}
+
+INLINE uint32x4_t addv(uint32x4_t a, uint32x4_t b) { return vaddq_u32(a, b); }
+
+INLINE uint32x4_t xorv(uint32x4_t a, uint32x4_t b) { return veorq_u32(a, b); }
+
+INLINE uint32x4_t set1(uint32_t x) { return vdupq_n_u32(x); }
+
+INLINE uint32x4_t set4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  const uint32_t array[4] = {a, b, c, d};
+  return vld1q_u32(array);
+}
+
+INLINE uint32x4_t rot16(uint32x4_t x) {
+  return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)));
+}
+
+INLINE uint32x4_t rot12(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 12), x, 12);
+}
+
+INLINE uint32x4_t rot8(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 8), x, 8);
+}
+
+INLINE uint32x4_t rot7(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 7), x, 7);
+}
+
+/* ========================================================================
+ *  Single-block compression: one row of the state per vector
+ * ======================================================================== */
+
+INLINE void g1(uint32x4_t *row0, uint32x4_t *row1, uint32x4_t *row2,
+               uint32x4_t *row3, uint32x4_t m) {
+  *row0 = addv(addv(*row0, m), *row1);
+  *row3 = rot16(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot12(xorv(*row1, *row2));
+}
+
+INLINE void g2(uint32x4_t *row0, uint32x4_t *row1, uint32x4_t *row2,
+               uint32x4_t *row3, uint32x4_t m) {
+  *row0 = addv(addv(*row0, m), *row1);
+  *row3 = rot8(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot7(xorv(*row1, *row2));
+}
+
+// Rotates rows 1-3 so the diagonals line up as columns: lane i then holds
+// G(i, 4 + (i+1)%4, 8 + (i+2)%4, 12 + (i+3)%4).
+INLINE void diagonalize(uint32x4_t *row1, uint32x4_t *row2, uint32x4_t *row3) {
+  *row1 = vextq_u32(*row1, *row1, 1);
+  *row2 = vextq_u32(*row2, *row2, 2);
+  *row3 = vextq_u32(*row3, *row3, 3);
+}
+
+INLINE void undiagonalize(uint32x4_t *row1, uint32x4_t *row2,
+                          uint32x4_t *row3) {
+  *row1 = vextq_u32(*row1, *row1, 3);
+  *row2 = vextq_u32(*row2, *row2, 2);
+  *row3 = vextq_u32(*row3, *row3, 1);
+}
+
+INLINE void compress_pre(uint32x4_t rows[4], const uint32_t cv[8],
+                         const uint8_t block[BLAKE3_BLOCK_LEN],
+                         uint8_t block_len, uint64_t counter, uint8_t flags) {
+  uint32_t m[16];
+  for (size_t i = 0; i < 16; i++) {
+    m[i] = load32(&block[4 * i]);
+  }
+
+  rows[0] = vld1q_u32(&cv[0]);
+  rows[1] = vld1q_u32(&cv[4]);
+  rows[2] = set4(IV[0], IV[1], IV[2], IV[3]);
+  rows[3] = set4(counter_low(counter), counter_high(counter),
+                 (uint32_t)block_len, (uint32_t)flags);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *s = MSG_SCHEDULE[r];
+    g1(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[0]], m[s[2]], m[s[4]], m[s[6]]));
+    g2(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[1]], m[s[3]], m[s[5]], m[s[7]]));
+    diagonalize(&rows[1], &rows[2], &rows[3]);
+    g1(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[8]], m[s[10]], m[s[12]], m[s[14]]));
+    g2(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[9]], m[s[11]], m[s[13]], m[s[15]]));
+    undiagonalize(&rows[1], &rows[2], &rows[3]);
+  }
+}
+
+void blake3_compress_in_place_neon(uint32_t cv[8],
+                                   const uint8_t block[BLAKE3_BLOCK_LEN],
+                                   uint8_t block_len, uint64_t counter,
+                                   uint8_t flags) {
+  uint32x4_t rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  vst1q_u32(&cv[0], xorv(rows[0], rows[2]));
+  vst1q_u32(&cv[4], xorv(rows[1], rows[3]));
+}
+
+void blake3_compress_xof_neon(const uint32_t cv[8],
+                              const uint8_t block[BLAKE3_BLOCK_LEN],
+                              uint8_t block_len, uint64_t counter,
+                              uint8_t flags, uint8_t out[64]) {
+  uint32x4_t rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu(xorv(rows[0], rows[2]), &out[0]);
+  storeu(xorv(rows[1], rows[3]), &out[16]);
+  storeu(xorv(rows[2], vld1q_u32(&cv[0])), &out[32]);
+  storeu(xorv(rows[3], vld1q_u32(&cv[4])), &out[48]);
+}
+
+/* ========================================================================
+ *  Four inputs at once: one state word of every input per vector
+ * ======================================================================== */
+
+INLINE void g(uint32x4_t v[16], size_t a, size_t b, size_t c, size_t d,
+              uint32x4_t x, uint32x4_t y) {
+  v[a] = addv(addv(v[a], v[b]), x);
+  v[d] = rot16(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot12(xorv(v[b], v[c]));
+  v[a] = addv(addv(v[a], v[b]), y);
+  v[d] = rot8(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot7(xorv(v[b], v[c]));
+}
+
+INLINE void round_fn(uint32x4_t v[16], const uint32x4_t m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+  g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+  g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+  g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+  g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+  g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+  g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+  g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+INLINE void transpose_vecs(uint32x4_t vecs[DEGREE]) {
+  // Transpose the 2x2 blocks, then swap the off-diagonal ones
+  uint32x4x2_t rows01 = vtrnq_u32(vecs[0], vecs[1]);
+  uint32x4x2_t rows23 = vtrnq_u32(vecs[2], vecs[3]);
+  vecs[0] = vcombine_u32(vget_low_u32(rows01.val[0]),
+                         vget_low_u32(rows23.val[0]));
+  vecs[1] = vcombine_u32(vget_low_u32(rows01.val[1]),
+                         vget_low_u32(rows23.val[1]));
+  vecs[2] = vcombine_u32(vget_high_u32(rows01.val[0]),
+                         vget_high_u32(rows23.val[0]));
+  vecs[3] = vcombine_u32(vget_high_u32(rows01.val[1]),
+                         vget_high_u32(rows23.val[1]));
+}
+
+INLINE void transpose_msg_vecs(const uint8_t *const *inputs,
+                               size_t block_offset, uint32x4_t out[16]) {
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t lane = 0; lane < DEGREE; lane++) {
+      out[4 * i + lane] = loadu(&inputs[lane][block_offset + 16 * i]);
+    }
+    transpose_vecs(&out[4 * i]);
+  }
+}
+
+INLINE void load_counters(uint64_t counter, bool increment_counter,
+                          uint32x4_t *out_lo, uint32x4_t *out_hi) {
+  uint64_t step = increment_counter ? 1 : 0;
+  uint64_t c0 = counter, c1 = counter + step, c2 = counter + 2 * step,
+           c3 = counter + 3 * step;
+  *out_lo = set4(counter_low(c0), counter_low(c1), counter_low(c2),
+                 counter_low(c3));
+  *out_hi = set4(counter_high(c0), counter_high(c1), counter_high(c2),
+                 counter_high(c3));
+}
+
+INLINE void hash4(const uint8_t *const *inputs, size_t blocks,
+                  const uint32_t key[8], uint64_t counter,
+                  bool increment_counter, uint8_t flags, uint8_t flags_start,
+                  uint8_t flags_end, uint8_t *out) {
+  uint32x4_t h_vecs[8];
+  for (size_t i = 0; i < 8; i++) {
+    h_vecs[i] = set1(key[i]);
+  }
+  uint32x4_t counter_low_vec, counter_high_vec;
+  load_counters(counter, increment_counter, &counter_low_vec,
+                &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    uint32x4_t msg_vecs[16];
+    transpose_msg_vecs(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    uint32x4_t v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],     h_vecs[3],
+        h_vecs[4],       h_vecs[5],        h_vecs[6],     h_vecs[7],
+        set1(IV[0]),     set1(IV[1]),      set1(IV[2]),   set1(IV[3]),
+        counter_low_vec, counter_high_vec, set1(BLAKE3_BLOCK_LEN),
+        set1(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++) {
+      round_fn(v, msg_vecs, r);
+    }
+    for (size_t i = 0; i < 8; i++) {
+      h_vecs[i] = xorv(v[i], v[i + 8]);
+    }
+    block_flags = flags;
+  }
+
+  // Back to one vector per input: h_vecs[i] and h_vecs[4 + i] are the two
+  // halves of input i's chaining value.
+  transpose_vecs(&h_vecs[0]);
+  transpose_vecs(&h_vecs[4]);
+  for (size_t lane = 0; lane < DEGREE; lane++) {
+    storeu(h_vecs[lane], &out[lane * BLAKE3_OUT_LEN]);
+    storeu(h_vecs[4 + lane], &out[lane * BLAKE3_OUT_LEN + 16]);
+  }
+}
+
+INLINE void hash_one(const uint8_t *input, size_t blocks,
+                     const uint32_t key[8], uint64_t counter, uint8_t flags,
+                     uint8_t flags_start, uint8_t flags_end,
+                     uint8_t out[BLAKE3_OUT_LEN]) {
+  uint32_t cv[8];
+  memcpy(cv, key, BLAKE3_KEY_LEN);
+  uint8_t block_flags = flags | flags_start;
+  while (blocks > 0) {
+    if (blocks == 1) {
+      block_flags |= flags_end;
+    }
+    blake3_compress_in_place_neon(cv, input, BLAKE3_BLOCK_LEN, counter,
+                                  block_flags);
+    input = &input[BLAKE3_BLOCK_LEN];
+    blocks -= 1;
+    block_flags = flags;
+  }
+  store_cv_words(out, cv);
+}
+
+void blake3_hash_many_neon(const uint8_t *const *inputs, size_t num_inputs,
+                           size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool increment_counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    hash4(inputs, blocks, key, counter, increment_counter, flags, flags_start,
+          flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+  while (num_inputs > 0) {
+    hash_one(inputs[0], blocks, key, counter, flags, flags_start, flags_end,
+             out);
+    if (increment_counter) {
+      counter += 1;
+    }
+    inputs += 1;
+    num_inputs -= 1;
+    out = &out[BLAKE3_OUT_LEN];
+  }
+}
+
+#endif // BLAKE3_USE_NEON
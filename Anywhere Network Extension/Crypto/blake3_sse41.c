@@ -0,0 +1,295 @@
+// SSE4.1 backend for BLAKE3 (x86-64).
+//
+// Built without -msse4.1: every function carries a target attribute, and
+// blake3_dispatch.c only calls in here after checking CPUID.
+
+#include "blake3_impl.h"
+
+#if defined(BLAKE3_USE_X86)
+
+#include <immintrin.h>
+
+#define DEGREE 4
+
+#define SSE41_INLINE INLINE __attribute__((target("sse4.1")))
+#define SSE41_FN __attribute__((target("sse4.1")))
+
+SSE41_INLINE __m128i loadu(const uint8_t src[16]) {
+  return _mm_loadu_si128((const __m128i *)src);
+}
+
+SSE41_INLINE void storeu(__m128i src, uint8_t dest[16]) {
+  _mm_storeu_si128((__m128i *)dest, src);
+}
+
+SSE41_INLINE __m128i addv(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+
+SSE41_INLINE __m128i xorv(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+
+SSE41_INLINE __m128i set1(uint32_t x) { return _mm_set1_epi32((int32_t)x); }
+
+SSE41_INLINE __m128i set4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return _mm_setr_epi32((int32_t)a, (int32_t)b, (int32_t)c, (int32_t)d);
+}
+
+SSE41_INLINE __m128i rot16(__m128i x) {
+  return _mm_shuffle_epi8(
+      x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+SSE41_INLINE __m128i rot12(__m128i x) {
+  return xorv(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 32 - 12));
+}
+
+SSE41_INLINE __m128i rot8(__m128i x) {
+  return _mm_shuffle_epi8(
+      x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+SSE41_INLINE __m128i rot7(__m128i x) {
+  return xorv(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 32 - 7));
+}
+
+/* ========================================================================
+ *  Single-block compression: one row of the state per vector
+ * ======================================================================== */
+
+SSE41_INLINE void g1(__m128i *row0, __m128i *row1, __m128i *row2,
+                     __m128i *row3, __m128i m) {
+  *row0 = addv(addv(*row0, m), *row1);
+  *row3 = rot16(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot12(xorv(*row1, *row2));
+}
+
+SSE41_INLINE void g2(__m128i *row0, __m128i *row1, __m128i *row2,
+                     __m128i *row3, __m128i m) {
+  *row0 = addv(addv(*row0, m), *row1);
+  *row3 = rot8(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot7(xorv(*row1, *row2));
+}
+
+// Rotates rows 1-3 so the diagonals line up as columns: lane i then holds
+// G(i, 4 + (i+1)%4, 8 + (i+2)%4, 12 + (i+3)%4).
+SSE41_INLINE void diagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(0, 3, 2, 1));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(2, 1, 0, 3));
+}
+
+SSE41_INLINE void undiagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(2, 1, 0, 3));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+SSE41_INLINE void compress_pre(__m128i rows[4], const uint32_t cv[8],
+                               const uint8_t block[BLAKE3_BLOCK_LEN],
+                               uint8_t block_len, uint64_t counter,
+                               uint8_t flags) {
+  uint32_t m[16];
+  for (size_t i = 0; i < 16; i++) {
+    m[i] = load32(&block[4 * i]);
+  }
+
+  rows[0] = loadu((const uint8_t *)&cv[0]);
+  rows[1] = loadu((const uint8_t *)&cv[4]);
+  rows[2] = set4(IV[0], IV[1], IV[2], IV[3]);
+  rows[3] = set4(counter_low(counter), counter_high(counter),
+                 (uint32_t)block_len, (uint32_t)flags);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *s = MSG_SCHEDULE[r];
+    g1(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[0]], m[s[2]], m[s[4]], m[s[6]]));
+    g2(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[1]], m[s[3]], m[s[5]], m[s[7]]));
+    diagonalize(&rows[1], &rows[2], &rows[3]);
+    g1(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[8]], m[s[10]], m[s[12]], m[s[14]]));
+    g2(&rows[0], &rows[1], &rows[2], &rows[3],
+       set4(m[s[9]], m[s[11]], m[s[13]], m[s[15]]));
+    undiagonalize(&rows[1], &rows[2], &rows[3]);
+  }
+}
+
+SSE41_FN
+void blake3_compress_in_place_sse41(uint32_t cv[8],
+                                    const uint8_t block[BLAKE3_BLOCK_LEN],
+                                    uint8_t block_len, uint64_t counter,
+                                    uint8_t flags) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu(xorv(rows[0], rows[2]), (uint8_t *)&cv[0]);
+  storeu(xorv(rows[1], rows[3]), (uint8_t *)&cv[4]);
+}
+
+SSE41_FN
+void blake3_compress_xof_sse41(const uint32_t cv[8],
+                               const uint8_t block[BLAKE3_BLOCK_LEN],
+                               uint8_t block_len, uint64_t counter,
+                               uint8_t flags, uint8_t out[64]) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu(xorv(rows[0], rows[2]), &out[0]);
+  storeu(xorv(rows[1], rows[3]), &out[16]);
+  storeu(xorv(rows[2], loadu((const uint8_t *)&cv[0])), &out[32]);
+  storeu(xorv(rows[3], loadu((const uint8_t *)&cv[4])), &out[48]);
+}
+
+/* ========================================================================
+ *  Four inputs at once: one state word of every input per vector
+ * ======================================================================== */
+
+SSE41_INLINE void g(__m128i v[16], size_t a, size_t b, size_t c, size_t d,
+                    __m128i x, __m128i y) {
+  v[a] = addv(addv(v[a], v[b]), x);
+  v[d] = rot16(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot12(xorv(v[b], v[c]));
+  v[a] = addv(addv(v[a], v[b]), y);
+  v[d] = rot8(xorv(v[d], v[a]));
+  v[c] = addv(v[c], v[d]);
+  v[b] = rot7(xorv(v[b], v[c]));
+}
+
+SSE41_INLINE void round_fn(__m128i v[16], const __m128i m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+  g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+  g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+  g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+  g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+  g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+  g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+  g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+SSE41_INLINE void transpose_vecs(__m128i vecs[DEGREE]) {
+  __m128i ab_01 = _mm_unpacklo_epi32(vecs[0], vecs[1]);
+  __m128i ab_23 = _mm_unpackhi_epi32(vecs[0], vecs[1]);
+  __m128i cd_01 = _mm_unpacklo_epi32(vecs[2], vecs[3]);
+  __m128i cd_23 = _mm_unpackhi_epi32(vecs[2], vecs[3]);
+  vecs[0] = _mm_unpacklo_epi64(ab_01, cd_01);
+  vecs[1] = _mm_unpackhi_epi64(ab_01, cd_01);
+  vecs[2] = _mm_unpacklo_epi64(ab_23, cd_23);
+  vecs[3] = _mm_unpackhi_epi64(ab_23, cd_23);
+}
+
+SSE41_INLINE void transpose_msg_vecs(const uint8_t *const *inputs,
+                                     size_t block_offset, __m128i out[16]) {
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t lane = 0; lane < DEGREE; lane++) {
+      out[4 * i + lane] = loadu(&inputs[lane][block_offset + 16 * i]);
+    }
+    transpose_vecs(&out[4 * i]);
+  }
+}
+
+SSE41_INLINE void load_counters(uint64_t counter, bool increment_counter,
+                                __m128i *out_lo, __m128i *out_hi) {
+  uint64_t step = increment_counter ? 1 : 0;
+  uint64_t c0 = counter, c1 = counter + step, c2 = counter + 2 * step,
+           c3 = counter + 3 * step;
+  *out_lo = set4(counter_low(c0), counter_low(c1), counter_low(c2),
+                 counter_low(c3));
+  *out_hi = set4(counter_high(c0), counter_high(c1), counter_high(c2),
+                 counter_high(c3));
+}
+
+SSE41_INLINE void hash4(const uint8_t *const *inputs, size_t blocks,
+                        const uint32_t key[8], uint64_t counter,
+                        bool increment_counter, uint8_t flags,
+                        uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+  __m128i h_vecs[8];
+  for (size_t i = 0; i < 8; i++) {
+    h_vecs[i] = set1(key[i]);
+  }
+  __m128i counter_low_vec, counter_high_vec;
+  load_counters(counter, increment_counter, &counter_low_vec,
+                &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m128i msg_vecs[16];
+    transpose_msg_vecs(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    __m128i v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],     h_vecs[3],
+        h_vecs[4],       h_vecs[5],        h_vecs[6],     h_vecs[7],
+        set1(IV[0]),     set1(IV[1]),      set1(IV[2]),   set1(IV[3]),
+        counter_low_vec, counter_high_vec, set1(BLAKE3_BLOCK_LEN),
+        set1(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++) {
+      round_fn(v, msg_vecs, r);
+    }
+    for (size_t i = 0; i < 8; i++) {
+      h_vecs[i] = xorv(v[i], v[i + 8]);
+    }
+    block_flags = flags;
+  }
+
+  // Back to one vector per input: h_vecs[i] and h_vecs[4 + i] are the two
+  // halves of input i's chaining value.
+  transpose_vecs(&h_vecs[0]);
+  transpose_vecs(&h_vecs[4]);
+  for (size_t lane = 0; lane < DEGREE; lane++) {
+    storeu(h_vecs[lane], &out[lane * BLAKE3_OUT_LEN]);
+    storeu(h_vecs[4 + lane], &out[lane * BLAKE3_OUT_LEN + 16]);
+  }
+}
+
+SSE41_INLINE void hash_one(const uint8_t *input, size_t blocks,
+                           const uint32_t key[8], uint64_t counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t out[BLAKE3_OUT_LEN]) {
+  uint32_t cv[8];
+  memcpy(cv, key, BLAKE3_KEY_LEN);
+  uint8_t block_flags = flags | flags_start;
+  while (blocks > 0) {
+    if (blocks == 1) {
+      block_flags |= flags_end;
+    }
+    blake3_compress_in_place_sse41(cv, input, BLAKE3_BLOCK_LEN, counter,
+                                   block_flags);
+    input = &input[BLAKE3_BLOCK_LEN];
+    blocks -= 1;
+    block_flags = flags;
+  }
+  store_cv_words(out, cv);
+}
+
+SSE41_FN
+void blake3_hash_many_sse41(const uint8_t *const *inputs, size_t num_inputs,
+                            size_t blocks, const uint32_t key[8],
+                            uint64_t counter, bool increment_counter,
+                            uint8_t flags, uint8_t flags_start,
+                            uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    hash4(inputs, blocks, key, counter, increment_counter, flags, flags_start,
+          flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+  while (num_inputs > 0) {
+    hash_one(inputs[0], blocks, key, counter, flags, flags_start, flags_end,
+             out);
+    if (increment_counter) {
+      counter += 1;
+    }
+    inputs += 1;
+    num_inputs -= 1;
+    out = &out[BLAKE3_OUT_LEN];
+  }
+}
+
+#endif // BLAKE3_USE_X86
@@ -36,18 +36,29 @@ class LWIPStack {
     private(set) var ipv6Enabled: Bool = false
     private var running = false
 
-    // lwIP periodic timeout timer
+    // One-shot timer for lwIP and flow timeouts, re-armed to the next deadline
     private var timeoutTimer: DispatchSourceTimer?
+    private var timeoutDeadline: DispatchTime?
+
+    /// Flow timeouts (UDP idle, TCP activity), serviced by ``timeoutTimer``.
+    let timerWheel = TimingWheel(tickInterval: 0.25)
 
     /// Mux manager for multiplexing UDP flows (created when Vision flow is active).
     var muxManager: MuxManager?
 
-    /// Active UDP flows keyed by 5-tuple string (e.g. "10.0.0.1:1234-8.8.8.8:53").
-    var udpFlows: [String: LWIPUDPFlow] = [:]
-    private var udpCleanupTimer: DispatchSourceTimer?
+    /// Active UDP flows keyed by binary 5-tuple.
+    var udpFlows: [UDPFlowKey: LWIPUDPFlow] = [:]
     private let maxUDPFlows = 200
     private let udpIdleTimeout: CFAbsoluteTime = 60
 
+    /// Maximum packets handed to `writePackets` per batch.
+    private let outputBatchMaxPackets: Int32 = 64
+    /// How long lwIP output may be held to coalesce batches (0 = flush when each bridge call returns).
+    private let outputFlushLatencyMs: UInt32 = 0
+
+    private static let protocolIPv4 = NSNumber(value: AF_INET)
+    private static let protocolIPv6 = NSNumber(value: AF_INET6)
+
     /// Singleton for C callback access (one NE process = one stack).
     static var shared: LWIPStack?
 
@@ -75,10 +86,8 @@ class LWIPStack {
                 self.muxManager = MuxManager(configuration: configuration, lwipQueue: self.lwipQueue)
             }
 
-            self.registerCallbacks()
-            lwip_bridge_init()
+            self.initBridge()
             self.startTimeoutTimer()
-            self.startUDPCleanupTimer()
             self.startReadingPackets()
             logger.info("[LWIPStack] Started, mux=\(self.muxManager != nil), ready for packets")
         }
@@ -117,10 +126,8 @@ class LWIPStack {
                 self.muxManager = MuxManager(configuration: newConfiguration, lwipQueue: self.lwipQueue)
             }
 
-            self.registerCallbacks()
-            lwip_bridge_init()
+            self.initBridge()
             self.startTimeoutTimer()
-            self.startUDPCleanupTimer()
             self.startReadingPackets()
             logger.info("[LWIPStack] Switched to new configuration, mux=\(self.muxManager != nil), ready for packets")
         }
@@ -132,8 +139,8 @@ class LWIPStack {
 
         self.timeoutTimer?.cancel()
         self.timeoutTimer = nil
-        self.udpCleanupTimer?.cancel()
-        self.udpCleanupTimer = nil
+        self.timeoutDeadline = nil
+        self.timerWheel.scheduleObserver = nil
 
         self.muxManager?.closeAll()
         self.muxManager = nil
@@ -143,25 +150,73 @@ class LWIPStack {
             flow.close()
         }
         self.udpFlows.removeAll()
+        self.timerWheel.removeAll()
 
         lwip_bridge_shutdown()
         logger.info("[LWIPStack] Shutdown complete, closed \(flowCount) UDP flows")
     }
 
+    /// Registers callbacks and brings up the lwIP bridge. Must be called on `lwipQueue`.
+    private func initBridge() {
+        registerCallbacks()
+        lwip_bridge_init()
+        // lwIP only reads input packets, so the NSData buffers from
+        // readPackets are referenced in place for the duration of each batch.
+        lwip_bridge_set_zero_copy_input(1)
+        lwip_bridge_set_output_batching(outputBatchMaxPackets, outputFlushLatencyMs)
+    }
+
     // MARK: - Callback Registration
 
     /// Registers C callbacks that route lwIP events through ``shared``.
     private func registerCallbacks() {
         // Output: lwIP → tunnel packet flow
-        lwip_bridge_set_output_fn { data, len, isIPv6 in
-            guard let shared = LWIPStack.shared, let data else { return }
-            let packetData = Data(bytes: data, count: Int(len))
-            let proto = isIPv6 != 0 ? NSNumber(value: AF_INET6) : NSNumber(value: AF_INET)
+        // Packets emitted during one bridge call arrive as a single batch of
+        // pbuf segments, valid only during the callback. They are gathered
+        // into one buffer, each packet is a slice of it, and the batch is
+        // written with one writePackets call.
+        lwip_bridge_set_output_batch_fn { iov, iovcnt, isIPv6, count in
+            guard let iov, let iovcnt, let isIPv6, count > 0 else { return }
+            var total = 0
+            var segments = 0
+            for i in 0..<Int(count) {
+                for _ in 0..<Int(iovcnt[i]) {
+                    total += iov[segments].iov_len
+                    segments += 1
+                }
+            }
+            guard total > 0, let buffer = malloc(total) else { return }
+
+            var packets = [Data]()
+            var protocols = [NSNumber]()
+            packets.reserveCapacity(Int(count))
+            protocols.reserveCapacity(Int(count))
+            let batch = Data(bytesNoCopy: buffer, count: total, deallocator: .free)
+            var offset = 0
+            var segment = 0
+            for i in 0..<Int(count) {
+                let start = offset
+                for _ in 0..<Int(iovcnt[i]) {
+                    if let base = iov[segment].iov_base {
+                        memcpy(buffer + offset, base, iov[segment].iov_len)
+                    }
+                    offset += iov[segment].iov_len
+                    segment += 1
+                }
+                packets.append(batch[start..<offset])
+                protocols.append(isIPv6[i] != 0 ? LWIPStack.protocolIPv6 : LWIPStack.protocolIPv4)
+            }
+            guard let shared = LWIPStack.shared else { return }
             shared.outputQueue.async {
-                shared.packetFlow?.writePackets([packetData], withProtocols: [proto])
+                shared.packetFlow?.writePackets(packets, withProtocols: protocols)
             }
         }
 
+        // Timeout: a bridge call started a timer due before the armed deadline
+        lwip_bridge_set_timeout_fn { delayMs in
+            LWIPStack.shared?.armTimeoutTimer(at: .now() + .milliseconds(Int(delayMs)))
+        }
+
         // TCP accept: create a new LWIPTCPConnection for each incoming connection
         lwip_bridge_set_tcp_accept_fn { srcIP, srcPort, dstIP, dstPort, isIPv6, pcb in
             guard let shared = LWIPStack.shared,
@@ -178,7 +233,8 @@ class LWIPStack {
 
             let dstHost = LWIPStack.ipAddrToString(dstIP, isIPv6: isIPv6 != 0)
             let conn = LWIPTCPConnection(pcb: pcb, dstHost: dstHost, dstPort: dstPort,
-                                          configuration: config, lwipQueue: shared.lwipQueue)
+                                          configuration: config, lwipQueue: shared.lwipQueue,
+                                          timerWheel: shared.timerWheel)
             return Unmanaged.passRetained(conn).toOpaque()
         }
 
@@ -196,6 +252,39 @@ class LWIPStack {
             }
         }
 
+        // TCP recv (zero-copy): wrap the pbuf payload without copying. The pbuf
+        // is released on lwipQueue once the last reference to the Data is gone,
+        // i.e. after the VLESS send has completed. Chained pbufs, or any
+        // received while no stack is running, are gathered into one Data and
+        // released immediately.
+        lwip_bridge_set_tcp_recv_ref_fn { conn, handle, iov, iovcnt, len in
+            guard let handle else {
+                logger.error("[LWIPStack] tcp_recv_ref: handle is nil")
+                return
+            }
+            guard let conn, let iov else {
+                logger.error("[LWIPStack] tcp_recv_ref: conn is nil")
+                lwip_bridge_pbuf_release(handle)
+                return
+            }
+            let tcpConn = Unmanaged<LWIPTCPConnection>.fromOpaque(conn).takeUnretainedValue()
+            if iovcnt == 1, let base = iov[0].iov_base, let queue = LWIPStack.shared?.lwipQueue {
+                let data = Data(bytesNoCopy: base, count: Int(len), deallocator: .custom { _, _ in
+                    queue.async { lwip_bridge_pbuf_release(handle) }
+                })
+                tcpConn.handleReceivedData(data)
+            } else {
+                var data = Data(capacity: Int(len))
+                for i in 0..<Int(iovcnt) {
+                    if let base = iov[i].iov_base {
+                        data.append(base.assumingMemoryBound(to: UInt8.self), count: iov[i].iov_len)
+                    }
+                }
+                lwip_bridge_pbuf_release(handle)
+                tcpConn.handleReceivedData(data)
+            }
+        }
+
         // TCP sent: notify the connection of acknowledged bytes
         lwip_bridge_set_tcp_sent_fn { conn, len in
             guard let conn else { return }
@@ -224,17 +313,21 @@ class LWIPStack {
             }
 
             let payload = Data(bytes: data, count: Int(len))
-            let srcHost = LWIPStack.ipAddrToString(srcIP, isIPv6: isIPv6 != 0)
-            let dstHost = LWIPStack.ipAddrToString(dstIP, isIPv6: isIPv6 != 0)
-            let flowKey = "\(srcHost):\(srcPort)-\(dstHost):\(dstPort)"
+            let flowKey = UDPFlowKey(srcIP: srcIP, srcPort: srcPort,
+                                     dstIP: dstIP, dstPort: dstPort,
+                                     isIPv6: isIPv6 != 0)
 
             if let flow = shared.udpFlows[flowKey] {
                 flow.handleReceivedData(payload, payloadLength: Int(len))
                 return
             }
 
+            // New flow: only now are the addresses formatted as strings
+            let srcHost = LWIPStack.ipAddrToString(srcIP, isIPv6: isIPv6 != 0)
+            let dstHost = LWIPStack.ipAddrToString(dstIP, isIPv6: isIPv6 != 0)
+
             guard shared.udpFlows.count < shared.maxUDPFlows else {
-                logger.error("[LWIPStack] UDP max flows reached (\(shared.maxUDPFlows)), dropping \(flowKey, privacy: .public)")
+                logger.error("[LWIPStack] UDP max flows reached (\(shared.maxUDPFlows)), dropping \(srcHost, privacy: .public):\(srcPort)-\(dstHost, privacy: .public):\(dstPort)")
                 return
             }
             guard let config = shared.configuration else { return }
@@ -250,7 +343,9 @@ class LWIPStack {
                 srcIPData: srcIPData, dstIPData: dstIPData,
                 isIPv6: isIPv6 != 0,
                 configuration: config,
-                lwipQueue: shared.lwipQueue
+                lwipQueue: shared.lwipQueue,
+                timerWheel: shared.timerWheel,
+                idleTimeout: shared.udpIdleTimeout
             )
             shared.udpFlows[flowKey] = flow
             flow.handleReceivedData(payload, payloadLength: Int(len))
@@ -260,16 +355,25 @@ class LWIPStack {
     // MARK: - Packet Reading
 
     /// Continuously reads IP packets from the tunnel and feeds them into lwIP.
+    ///
+    /// Each read is handed to lwIP as a single batch so TCP output is flushed
+    /// once per connection rather than once per packet.
     private func startReadingPackets() {
         packetFlow?.readPackets { [weak self] packets, protocols in
             guard let self, self.running else { return }
 
             self.lwipQueue.async {
-                for i in 0..<packets.count {
-                    packets[i].withUnsafeBytes { buffer in
-                        guard let baseAddress = buffer.baseAddress else { return }
-                        lwip_bridge_input(baseAddress, Int32(buffer.count))
-                    }
+                // NSData keeps its bytes at a stable address for its lifetime,
+                // so all pointers stay valid for the duration of the batch call.
+                let buffers = packets.map { $0 as NSData }
+                var pointers = [UnsafeRawPointer?](repeating: nil, count: buffers.count)
+                var lengths = [Int32](repeating: 0, count: buffers.count)
+                for i in 0..<buffers.count {
+                    pointers[i] = buffers[i].bytes
+                    lengths[i] = Int32(buffers[i].length)
+                }
+                withExtendedLifetime(buffers) {
+                    lwip_bridge_input_batch(&pointers, &lengths, Int32(buffers.count))
                 }
             }
 
@@ -279,39 +383,43 @@ class LWIPStack {
 
     // MARK: - Timers
 
-    /// Starts the lwIP periodic timeout timer (250ms interval).
+    /// Starts the timeout timer. Instead of polling, it is armed for the
+    /// earlier of lwIP's next timeout and the timer wheel's next deadline,
+    /// moved earlier when either gains a sooner one, and left idle when
+    /// neither has any.
     private func startTimeoutTimer() {
         let timer = DispatchSource.makeTimerSource(queue: lwipQueue)
-        timer.schedule(deadline: .now() + .milliseconds(250),
-                       repeating: .milliseconds(250))
         timer.setEventHandler { [weak self] in
             guard let self, self.running else { return }
-            lwip_bridge_check_timeouts()
+            self.timeoutDeadline = nil
+            self.serviceTimeouts()
         }
         timer.resume()
         timeoutTimer = timer
+        timerWheel.scheduleObserver = { [weak self] deadline in
+            self?.armTimeoutTimer(at: deadline)
+        }
+        serviceTimeouts()
     }
 
-    /// Starts the UDP flow cleanup timer (1-second interval, 60-second idle timeout).
-    private func startUDPCleanupTimer() {
-        let timer = DispatchSource.makeTimerSource(queue: lwipQueue)
-        timer.schedule(deadline: .now() + .seconds(1), repeating: .seconds(1))
-        timer.setEventHandler { [weak self] in
-            guard let self, self.running else { return }
-            let now = CFAbsoluteTimeGetCurrent()
-            var keysToRemove: [String] = []
-            for (key, flow) in self.udpFlows {
-                if now - flow.lastActivity > self.udpIdleTimeout {
-                    flow.close()
-                    keysToRemove.append(key)
-                }
-            }
-            for key in keysToRemove {
-                self.udpFlows.removeValue(forKey: key)
-            }
+    /// Runs due lwIP timeouts and flow timeouts, then re-arms the timer.
+    private func serviceTimeouts() {
+        let delayMs = lwip_bridge_check_timeouts()
+        timerWheel.advance()
+        if delayMs != LWIP_BRIDGE_TIMEOUT_NONE {
+            armTimeoutTimer(at: .now() + .milliseconds(Int(delayMs)))
         }
-        timer.resume()
-        udpCleanupTimer = timer
+        if let deadline = timerWheel.nextDeadline {
+            armTimeoutTimer(at: deadline)
+        }
+    }
+
+    /// Arms the timer for `deadline` unless it is already armed earlier.
+    private func armTimeoutTimer(at deadline: DispatchTime) {
+        guard let timer = timeoutTimer else { return }
+        if let armed = timeoutDeadline, armed <= deadline { return }
+        timeoutDeadline = deadline
+        timer.schedule(deadline: deadline, repeating: .never, leeway: .milliseconds(5))
     }
 
     // MARK: - IP Address Helpers
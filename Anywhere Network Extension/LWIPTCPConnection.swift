@@ -39,6 +39,10 @@ class LWIPTCPConnection {
     /// Whether the VLESS receive loop is paused due to a full lwIP send buffer.
     private var receivePaused = false
 
+    /// Smallest write queued by reference instead of copied into lwIP; below
+    /// this the bookkeeping costs more than the copy.
+    private static let zeroCopyWriteThreshold = 512
+
     // MARK: Activity Timeout (matches Xray-core policy defaults)
 
     /// Inactivity timeout for the connection (Xray-core `connIdle`, default 300s).
@@ -50,6 +54,7 @@ class LWIPTCPConnection {
     /// Timeout after downlink (remote → local) finishes (Xray-core `uplinkOnly`, default 1s).
     private static let uplinkOnlyTimeout: TimeInterval = 1
 
+    private let timerWheel: TimingWheel
     private var activityTimer: ActivityTimer?
     private var uplinkDone = false
     private var downlinkDone = false
@@ -57,12 +62,14 @@ class LWIPTCPConnection {
     // MARK: Lifecycle
 
     init(pcb: UnsafeMutableRawPointer, dstHost: String, dstPort: UInt16,
-         configuration: VLESSConfiguration, lwipQueue: DispatchQueue) {
+         configuration: VLESSConfiguration, lwipQueue: DispatchQueue,
+         timerWheel: TimingWheel) {
         self.pcb = pcb
         self.dstHost = dstHost
         self.dstPort = dstPort
         self.configuration = configuration
         self.lwipQueue = lwipQueue
+        self.timerWheel = timerWheel
 
         connectVLESS()
     }
@@ -73,6 +80,8 @@ class LWIPTCPConnection {
     ///
     /// Forwards data to the VLESS proxy. The TCP receive window is only advanced
     /// after the VLESS send completes, providing natural backpressure.
+    /// `data` may reference an lwIP pbuf without copying; it is kept alive
+    /// until the send completes so that the pbuf is released only afterwards.
     func handleReceivedData(_ data: Data) {
         guard !closed else { return }
         activityTimer?.update()
@@ -80,6 +89,7 @@ class LWIPTCPConnection {
         if let conn = vlessConnection {
             let dataLen = UInt16(data.count)
             conn.send(data: data) { [weak self] error in
+                withExtendedLifetime(data) {}
                 guard let self else { return }
                 if let error {
                     logger.error("[TCP] VLESS send error for \(self.dstHost, privacy: .public):\(self.dstPort): \(error.localizedDescription, privacy: .public)")
@@ -149,7 +159,7 @@ class LWIPTCPConnection {
                     self.vlessClient = client
                     self.vlessConnection = vlessConnection
                     self.activityTimer = ActivityTimer(
-                        queue: self.lwipQueue,
+                        wheel: self.timerWheel,
                         timeout: Self.connectionIdleTimeout
                     ) { [weak self] in
                         guard let self, !self.closed else { return }
@@ -227,33 +237,50 @@ class LWIPTCPConnection {
     /// Writes as much data as the lwIP send buffer can accept. Any remainder
     /// is stored in ``overflowBuffer`` and the receive loop pauses until
     /// ``handleSent(len:)`` drains the overflow and resumes receiving.
+    ///
+    /// Chunks of at least ``zeroCopyWriteThreshold`` bytes are queued by
+    /// reference: lwIP keeps a retained `NSData` until the bytes are
+    /// acknowledged by the local app, avoiding a copy into segment memory.
     private func writeToLWIP(_ data: Data) {
         guard !closed else { return }
 
+        let buffer = data as NSData
+        let base = buffer.bytes
+        let count = buffer.length
         var offset = 0
-        data.withUnsafeBytes { buffer in
-            guard let base = buffer.baseAddress else { return }
-            while offset < data.count {
-                var sndbuf = Int(lwip_bridge_tcp_sndbuf(pcb))
+        while offset < count {
+            var sndbuf = Int(lwip_bridge_tcp_sndbuf(pcb))
+            if sndbuf <= 0 {
+                lwip_bridge_tcp_output(pcb)
+                sndbuf = Int(lwip_bridge_tcp_sndbuf(pcb))
                 if sndbuf <= 0 {
-                    lwip_bridge_tcp_output(pcb)
-                    sndbuf = Int(lwip_bridge_tcp_sndbuf(pcb))
-                    if sndbuf <= 0 {
-                        overflowBuffer.append(Data(bytes: base + offset, count: data.count - offset))
-                        offset = data.count
-                        break
-                    }
+                    overflowBuffer.append(Data(bytes: base + offset, count: count - offset))
+                    offset = count
+                    break
                 }
-                let chunkSize = min(sndbuf, data.count - offset)
-                let writeLen = UInt16(min(chunkSize, Int(UInt16.max)))
-                let err = lwip_bridge_tcp_write(pcb, base + offset, writeLen)
+            }
+            let chunkSize = min(sndbuf, count - offset, Int(UInt16.max))
+            let writeLen = UInt16(chunkSize)
+            var err: Int32 = -1
+            if chunkSize >= Self.zeroCopyWriteThreshold {
+                let ctx = Unmanaged.passRetained(buffer).toOpaque()
+                err = lwip_bridge_tcp_write_ref(pcb, base + offset, writeLen, { ctx in
+                    guard let ctx else { return }
+                    Unmanaged<NSData>.fromOpaque(ctx).release()
+                }, ctx)
                 if err != 0 {
-                    logger.error("[TCP] tcp_write error: \(err) for \(self.dstHost, privacy: .public):\(self.dstPort)")
-                    self.abort()
-                    return
+                    Unmanaged<NSData>.fromOpaque(ctx).release()
                 }
-                offset += chunkSize
             }
+            if err != 0 {
+                err = lwip_bridge_tcp_write(pcb, base + offset, writeLen)
+            }
+            if err != 0 {
+                logger.error("[TCP] tcp_write error: \(err) for \(self.dstHost, privacy: .public):\(self.dstPort)")
+                self.abort()
+                return
+            }
+            offset += chunkSize
         }
 
         lwip_bridge_tcp_output(pcb)
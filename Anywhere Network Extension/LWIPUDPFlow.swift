@@ -15,8 +15,51 @@ import os.log
 
 private let logger = Logger(subsystem: "com.argsment.Anywhere.Network-Extension", category: "LWIP-UDP")
 
+// MARK: - UDPFlowKey
+
+/// Fixed-size UDP 5-tuple used to key ``LWIPStack/udpFlows``.
+///
+/// Built straight from the raw address bytes lwIP hands to the receive
+/// callback, so looking up an existing flow neither formats nor allocates.
+/// IPv4 addresses occupy the low half of the `Hi` words.
+struct UDPFlowKey: Hashable {
+    let srcAddrHi: UInt64
+    let srcAddrLo: UInt64
+    let dstAddrHi: UInt64
+    let dstAddrLo: UInt64
+    let srcPort: UInt16
+    let dstPort: UInt16
+    let isIPv6: Bool
+
+    init(srcIP: UnsafeRawPointer, srcPort: UInt16,
+         dstIP: UnsafeRawPointer, dstPort: UInt16,
+         isIPv6: Bool) {
+        if isIPv6 {
+            srcAddrHi = srcIP.loadUnaligned(as: UInt64.self)
+            srcAddrLo = srcIP.loadUnaligned(fromByteOffset: 8, as: UInt64.self)
+            dstAddrHi = dstIP.loadUnaligned(as: UInt64.self)
+            dstAddrLo = dstIP.loadUnaligned(fromByteOffset: 8, as: UInt64.self)
+        } else {
+            srcAddrHi = UInt64(srcIP.loadUnaligned(as: UInt32.self))
+            srcAddrLo = 0
+            dstAddrHi = UInt64(dstIP.loadUnaligned(as: UInt32.self))
+            dstAddrLo = 0
+        }
+        self.srcPort = srcPort
+        self.dstPort = dstPort
+        self.isIPv6 = isIPv6
+    }
+
+    /// Calls `body` with the source address bytes (4 or 16, network order).
+    func withSourceAddress<T>(_ body: (UnsafeRawPointer) -> T) -> T {
+        withUnsafeBytes(of: (srcAddrHi, srcAddrLo)) { body($0.baseAddress!) }
+    }
+}
+
+// MARK: - LWIPUDPFlow
+
 class LWIPUDPFlow {
-    let flowKey: String
+    let flowKey: UDPFlowKey
     let srcHost: String
     let srcPort: UInt16
     let dstHost: String
@@ -30,6 +73,9 @@ class LWIPUDPFlow {
     let dstIPBytes: Data  // original destination (becomes src in response)
 
     var lastActivity: CFAbsoluteTime = CFAbsoluteTimeGetCurrent()
+    private let timerWheel: TimingWheel
+    private let idleTimeout: CFAbsoluteTime
+    private var idleEntry: TimingWheel.Entry?
 
     // Non-mux path
     private var vlessClient: VLESSClient?
@@ -43,13 +89,18 @@ class LWIPUDPFlow {
     private var pendingIsMux = false       // tracks which format pendingData uses
     private var closed = false
 
-    init(flowKey: String,
+    /// Human-readable 5-tuple for log messages.
+    var flowDescription: String { "\(srcHost):\(srcPort)-\(dstHost):\(dstPort)" }
+
+    init(flowKey: UDPFlowKey,
          srcHost: String, srcPort: UInt16,
          dstHost: String, dstPort: UInt16,
          srcIPData: Data, dstIPData: Data,
          isIPv6: Bool,
          configuration: VLESSConfiguration,
-         lwipQueue: DispatchQueue) {
+         lwipQueue: DispatchQueue,
+         timerWheel: TimingWheel,
+         idleTimeout: CFAbsoluteTime) {
         self.flowKey = flowKey
         self.srcHost = srcHost
         self.srcPort = srcPort
@@ -60,6 +111,12 @@ class LWIPUDPFlow {
         self.isIPv6 = isIPv6
         self.configuration = configuration
         self.lwipQueue = lwipQueue
+        self.timerWheel = timerWheel
+        self.idleTimeout = idleTimeout
+
+        let entry = timerWheel.makeEntry { [weak self] in self?.checkIdle() }
+        idleEntry = entry
+        timerWheel.schedule(entry, after: idleTimeout)
     }
 
     // MARK: - Data Handling (called on lwipQueue)
@@ -74,7 +131,7 @@ class LWIPUDPFlow {
         if let session = muxSession {
             session.send(data: Data(payload)) { [weak self] error in
                 if let error {
-                    logger.error("[UDP] Mux send error for \(self?.flowKey ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
+                    logger.error("[UDP] Mux send error for \(self?.flowDescription ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
                 }
             }
             return
@@ -119,7 +176,7 @@ class LWIPUDPFlow {
 
         conn.sendRaw(data: framedPayload) { [weak self] error in
             if let error {
-                logger.error("[UDP] VLESS send error for \(self?.flowKey ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
+                logger.error("[UDP] VLESS send error for \(self?.flowDescription ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
             }
         }
     }
@@ -135,7 +192,9 @@ class LWIPUDPFlow {
             // Cone NAT: GlobalID = blake3("udp:srcHost:srcPort") matching Xray-core's
             // net.Destination.String() format. Non-zero GlobalID enables server-side
             // session persistence (Full Cone NAT). Nil = no GlobalID (Symmetric NAT).
-            let globalID = configuration.xudpEnabled ? XUDP.generateGlobalID(sourceAddress: "udp:\(srcHost):\(srcPort)") : nil
+            let globalID = configuration.xudpEnabled ? flowKey.withSourceAddress {
+                XUDP.generateGlobalID(sourceIP: $0, isIPv6: flowKey.isIPv6, sourcePort: srcPort)
+            } : nil
             muxManager.dispatch(network: .udp, host: dstHost, port: dstPort, globalID: globalID) { [weak self] result in
                 guard let self else { return }
 
@@ -165,14 +224,14 @@ class LWIPUDPFlow {
                         for payload in buffered {
                             session.send(data: payload) { [weak self] error in
                                 if let error {
-                                    logger.error("[UDP] Mux initial send error for \(self?.flowKey ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
+                                    logger.error("[UDP] Mux initial send error for \(self?.flowDescription ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
                                 }
                             }
                         }
 
                     case .failure(let error):
                         if case .dropped = error as? VLESSError {} else {
-                            logger.error("[UDP] Mux dispatch failed: \(self.flowKey, privacy: .public): \(error.localizedDescription, privacy: .public)")
+                            logger.error("[UDP] Mux dispatch failed: \(self.flowDescription, privacy: .public): \(error.localizedDescription, privacy: .public)")
                         }
                         self.releaseVLESS()
                         LWIPStack.shared?.udpFlows.removeValue(forKey: self.flowKey)
@@ -205,7 +264,7 @@ class LWIPUDPFlow {
                             // Use sendRaw because pendingData is already length-framed
                             vlessConnection.sendRaw(data: dataToSend) { [weak self] error in
                                 if let error {
-                                    logger.error("[UDP] VLESS initial send error for \(self?.flowKey ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
+                                    logger.error("[UDP] VLESS initial send error for \(self?.flowDescription ?? "?", privacy: .public): \(error.localizedDescription, privacy: .public)")
                                 }
                             }
                         }
@@ -215,7 +274,7 @@ class LWIPUDPFlow {
 
                     case .failure(let error):
                         if case .dropped = error as? VLESSError {} else {
-                            logger.error("[UDP] connect failed: \(self.flowKey, privacy: .public): \(error.localizedDescription, privacy: .public)")
+                            logger.error("[UDP] connect failed: \(self.flowDescription, privacy: .public): \(error.localizedDescription, privacy: .public)")
                         }
                         self.releaseVLESS()
                         LWIPStack.shared?.udpFlows.removeValue(forKey: self.flowKey)
@@ -232,7 +291,7 @@ class LWIPUDPFlow {
         } errorHandler: { [weak self] error in
             guard let self else { return }
             if let error {
-                logger.error("[UDP] VLESS recv error: \(self.flowKey, privacy: .public): \(error.localizedDescription, privacy: .public)")
+                logger.error("[UDP] VLESS recv error: \(self.flowDescription, privacy: .public): \(error.localizedDescription, privacy: .public)")
             }
             self.lwipQueue.async {
                 self.close()
@@ -270,10 +329,43 @@ class LWIPUDPFlow {
 
     // MARK: - Close
 
+    /// Closes the flow once no datagram has moved in either direction for
+    /// `idleTimeout`. Activity only stamps ``lastActivity``; the entry is
+    /// re-armed for the remainder when it expires.
+    private func checkIdle() {
+        guard !closed, let entry = idleEntry else { return }
+        let idle = CFAbsoluteTimeGetCurrent() - lastActivity
+        if idle < idleTimeout {
+            timerWheel.schedule(entry, after: idleTimeout - idle)
+            return
+        }
+        close()
+        LWIPStack.shared?.udpFlows.removeValue(forKey: flowKey)
+    }
+
+    /// Must be called on `lwipQueue`.
     func close() {
         guard !closed else { return }
         closed = true
+        if let entry = idleEntry { timerWheel.cancel(entry) }
+        idleEntry = nil
         releaseVLESS()
+        releaseLWIPPCB()
+    }
+
+    /// Drops the PCB the bridge keeps for this flow's responses.
+    private func releaseLWIPPCB() {
+        dstIPBytes.withUnsafeBytes { dstPtr in
+            srcIPBytes.withUnsafeBytes { srcPtr in
+                guard let dstBase = dstPtr.baseAddress,
+                      let srcBase = srcPtr.baseAddress else { return }
+                lwip_bridge_udp_release(
+                    dstBase, dstPort,
+                    srcBase, srcPort,
+                    isIPv6 ? 1 : 0
+                )
+            }
+        }
     }
 
     private func releaseVLESS() {
@@ -291,6 +383,7 @@ class LWIPUDPFlow {
     }
 
     deinit {
+        if let idleEntry { timerWheel.cancel(idleEntry) }
         vlessConnection?.cancel()
         vlessClient?.cancel()
         muxSession?.close()
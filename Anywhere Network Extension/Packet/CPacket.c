@@ -22,6 +22,10 @@ void xor_nonce_with_seq(uint8_t *nonce, uint64_t seqNum) {
     nonce[11] ^= (uint8_t)(seqNum);
 }
 
+uint64_t tls_seq_reserve(uint64_t *counter, uint64_t count) {
+    return __atomic_fetch_add(counter, count, __ATOMIC_RELAXED);
+}
+
 void copy_payload(uint8_t *dst, const uint8_t *src, size_t length) {
     memcpy(dst, src, length);
 }
@@ -19,6 +19,12 @@
 /// @param seqNum 64-bit sequence number
 void xor_nonce_with_seq(uint8_t *nonce, uint64_t seqNum);
 
+/// Atomically reserve consecutive record sequence numbers
+/// @param counter Next unused sequence number (advanced by count)
+/// @param count Number of sequence numbers to reserve
+/// @return The first reserved sequence number
+uint64_t tls_seq_reserve(uint64_t *counter, uint64_t count);
+
 /// Copy payload to packet buffer
 /// @param dst Destination buffer
 /// @param src Source data
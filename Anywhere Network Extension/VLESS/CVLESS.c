@@ -187,3 +187,228 @@ int parse_vless_address(const char *str, size_t strLen,
     *outLen = strLen;
     return 1;
 }
+
+size_t vision_unpad(vision_unpad_state *state,
+                    const uint8_t *data, size_t length,
+                    uint8_t *out) {
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < length) {
+        if (state->remaining_command > 0) {
+            // Command header, one byte at a time (it may span reads)
+            uint8_t byte = data[pos++];
+            switch (state->remaining_command) {
+            case 5: state->current_command = byte; break;
+            case 4: state->remaining_content = (int32_t)byte << 8; break;
+            case 3: state->remaining_content |= byte; break;
+            case 2: state->remaining_padding = (int32_t)byte << 8; break;
+            case 1: state->remaining_padding |= byte; break;
+            default: break;
+            }
+            state->remaining_command--;
+        } else if (state->remaining_content > 0) {
+            size_t n = length - pos;
+            if (n > (size_t)state->remaining_content) n = (size_t)state->remaining_content;
+            memcpy(out + written, data + pos, n);
+            written += n;
+            pos += n;
+            state->remaining_content -= (int32_t)n;
+        } else if (state->remaining_padding > 0) {
+            size_t n = length - pos;
+            if (n > (size_t)state->remaining_padding) n = (size_t)state->remaining_padding;
+            pos += n;
+            state->remaining_padding -= (int32_t)n;
+        }
+
+        // Current frame done
+        if (state->remaining_command <= 0 && state->remaining_content <= 0 &&
+            state->remaining_padding <= 0) {
+            if (state->current_command == 0) {
+                // Continue: another frame follows
+                state->remaining_command = 5;
+            } else {
+                // End or Direct: back to the initial state, the rest is raw
+                state->remaining_command = -1;
+                state->remaining_content = -1;
+                state->remaining_padding = -1;
+                memcpy(out + written, data + pos, length - pos);
+                written += length - pos;
+                break;
+            }
+        }
+    }
+
+    return written;
+}
+
+// MARK: - Vision Reshaping
+
+/// Last occurrence of c in [begin, end), or NULL. Scans backwards a word at a
+/// time and only looks at single bytes in words that contain a match.
+static const uint8_t *find_last_byte(const uint8_t *begin, const uint8_t *end, uint8_t c) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t pattern = ones * c;
+
+    while (end - begin >= 8) {
+        uint64_t word;
+        memcpy(&word, end - 8, sizeof(word));
+        uint64_t x = word ^ pattern;
+        if ((x - ones) & ~x & highs) {
+            for (int i = 7; i >= 0; i--) {
+                if (end[i - 8] == c) return end + i - 8;
+            }
+        }
+        end -= 8;
+    }
+    while (end > begin) {
+        if (*--end == c) return end;
+    }
+    return NULL;
+}
+
+size_t vision_reshape_split(const uint8_t *data, size_t length, size_t limit) {
+    // Candidates need 3 bytes and an offset in [21, limit]
+    if (length >= 3 + 21) {
+        const uint8_t *begin = data + 21;
+        const uint8_t *end = data + (length - 3 < limit ? length - 3 : limit) + 1;
+        while (begin < end) {
+            const uint8_t *p = find_last_byte(begin, end, 0x17);
+            if (!p) break;
+            if (p[1] == 0x03 && p[2] == 0x03) return (size_t)(p - data);
+            end = p;
+        }
+    }
+    return length / 2;
+}
+
+// MARK: - TLS Record Tracking
+
+int vision_record_tracker_feed(vision_record_tracker *tracker,
+                               const uint8_t *data, size_t length) {
+    if (tracker->desynced) {
+        // Like a per-chunk parse, assume the new chunk starts a record
+        tracker->record_remaining = 0;
+        tracker->header_length = 0;
+        tracker->desynced = 0;
+    }
+
+    int complete = length >= 5 && tracker->record_remaining == 0 && tracker->header_length == 0;
+    size_t offset = 0;
+
+    while (offset < length) {
+        if (tracker->record_remaining > 0) {
+            size_t skip = length - offset;
+            if (skip > tracker->record_remaining) skip = tracker->record_remaining;
+            tracker->record_remaining -= (uint32_t)skip;
+            offset += skip;
+            continue;
+        }
+
+        size_t take = 5 - tracker->header_length;
+        if (take > length - offset) take = length - offset;
+        memcpy(tracker->header + tracker->header_length, data + offset, take);
+        tracker->header_length += (uint8_t)take;
+        offset += take;
+        if (tracker->header_length < 5) break;
+        tracker->header_length = 0;
+
+        // Content types 20-24 (change_cipher_spec .. heartbeat), version 3.x
+        const uint8_t *h = tracker->header;
+        if (h[0] < 0x14 || h[0] > 0x18 || h[1] != 0x03) {
+            tracker->desynced = 1;
+            return 0;
+        }
+        if (h[0] != 0x17 || h[2] != 0x03) complete = 0;
+        tracker->record_remaining = (uint32_t)h[3] << 8 | h[4];
+    }
+
+    return complete && tracker->record_remaining == 0 && tracker->header_length == 0;
+}
+
+int vision_find_tls13_version(uint8_t *matched, const uint8_t *data, size_t length) {
+    static const uint8_t pattern[6] = { 0x00, 0x2b, 0x00, 0x02, 0x03, 0x04 };
+    // Longest proper prefix of pattern[0..i] that is also its suffix
+    static const uint8_t fallback[6] = { 0, 0, 1, 0, 0, 0 };
+
+    size_t m = *matched;
+    for (size_t i = 0; i < length; i++) {
+        while (m > 0 && data[i] != pattern[m]) m = fallback[m - 1];
+        if (data[i] == pattern[m] && ++m == sizeof(pattern)) {
+            *matched = 0;
+            return 1;
+        }
+    }
+    *matched = (uint8_t)m;
+    return 0;
+}
+
+// MARK: - Vision Padding Keystream
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(x, a, b, c, d)                 \
+    x[a] += x[b]; x[d] = ROTL32(x[d] ^ x[a], 16);   \
+    x[c] += x[d]; x[b] = ROTL32(x[b] ^ x[c], 12);   \
+    x[a] += x[b]; x[d] = ROTL32(x[d] ^ x[a], 8);    \
+    x[c] += x[d]; x[b] = ROTL32(x[b] ^ x[c], 7)
+
+/// One ChaCha20 block (RFC 8439 2.3), then advance the 64-bit counter
+static void chacha20_block(uint32_t state[16], uint8_t out[64]) {
+    uint32_t x[16];
+    memcpy(x, state, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QUARTERROUND(x, 0, 4, 8, 12);
+        QUARTERROUND(x, 1, 5, 9, 13);
+        QUARTERROUND(x, 2, 6, 10, 14);
+        QUARTERROUND(x, 3, 7, 11, 15);
+        QUARTERROUND(x, 0, 5, 10, 15);
+        QUARTERROUND(x, 1, 6, 11, 12);
+        QUARTERROUND(x, 2, 7, 8, 13);
+        QUARTERROUND(x, 3, 4, 9, 14);
+    }
+    for (int i = 0; i < 16; i++) {
+        uint32_t v = x[i] + state[i];
+        out[i * 4 + 0] = (uint8_t)(v);
+        out[i * 4 + 1] = (uint8_t)(v >> 8);
+        out[i * 4 + 2] = (uint8_t)(v >> 16);
+        out[i * 4 + 3] = (uint8_t)(v >> 24);
+    }
+    if (++state[12] == 0) state[13]++;
+}
+
+void vision_keystream_init(vision_keystream *ks, const uint8_t *seed) {
+    static const uint32_t sigma[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+    memcpy(ks->state, sigma, sizeof(sigma));
+    for (int i = 0; i < 8; i++) {
+        const uint8_t *k = seed + i * 4;
+        ks->state[4 + i] = (uint32_t)k[0] | (uint32_t)k[1] << 8 |
+                           (uint32_t)k[2] << 16 | (uint32_t)k[3] << 24;
+    }
+    ks->state[12] = ks->state[13] = ks->state[14] = ks->state[15] = 0;
+    ks->available = 0;
+}
+
+void vision_keystream_fill(vision_keystream *ks, uint8_t *out, size_t length) {
+    // Leftover bytes from the last block first
+    size_t n = length < ks->available ? length : ks->available;
+    memcpy(out, ks->block + sizeof(ks->block) - ks->available, n);
+    ks->available -= n;
+    out += n;
+    length -= n;
+
+    // Whole blocks straight into the output
+    while (length >= sizeof(ks->block)) {
+        chacha20_block(ks->state, out);
+        out += sizeof(ks->block);
+        length -= sizeof(ks->block);
+    }
+
+    // Buffer one more block for the tail
+    if (length > 0) {
+        chacha20_block(ks->state, ks->block);
+        memcpy(out, ks->block, length);
+        ks->available = sizeof(ks->block) - length;
+    }
+}
@@ -61,4 +61,83 @@ int parse_ipv6_address(const char *str, size_t strLen, uint8_t *outBytes);
 int parse_vless_address(const char *str, size_t strLen,
                         uint8_t *outType, uint8_t *outBytes, size_t *outLen);
 
+/// Vision unpadding reader state, mirrored from VisionTrafficState
+/// (remainingCommand / remainingContent / remainingPadding / currentCommand)
+typedef struct {
+    int32_t remaining_command;
+    int32_t remaining_content;
+    int32_t remaining_padding;
+    int32_t current_command;
+} vision_unpad_state;
+
+/// Strip Vision padding frames from a received span, resuming from state
+/// Frame: [command (1)] [contentLen (2)] [paddingLen (2)] [content] [padding]
+/// After an End/Direct frame the state resets to -1 and the rest of the span
+/// is passed through as content.
+/// @param state Reader state, updated in place (the UUID prefix must already
+///              be consumed)
+/// @param data Received bytes
+/// @param length Length of data
+/// @param out Output buffer for content (at least length bytes)
+/// @return Number of content bytes written to out
+size_t vision_unpad(vision_unpad_state *state,
+                    const uint8_t *data, size_t length,
+                    uint8_t *out);
+
+/// Find where to split a payload too large for one Vision frame
+/// (Xray-core ReshapeMultiBuffer): the last TLS application data header
+/// (17 03 03) starting at an offset in [21, limit], else the midpoint
+/// @param data Payload
+/// @param length Payload length
+/// @param limit Largest acceptable split offset
+/// @return Split offset (first chunk length)
+size_t vision_reshape_split(const uint8_t *data, size_t length, size_t limit);
+
+/// Running TLS record framing of one direction of a stream, so each chunk is
+/// classified from the bytes it adds rather than by re-parsing from its start
+typedef struct {
+    uint32_t record_remaining;  // body bytes left in the current record
+    uint8_t  header[5];         // partial record header split across chunks
+    uint8_t  header_length;
+    uint8_t  desynced;          // framing lost; re-anchor at the next chunk
+} vision_record_tracker;
+
+/// Advance the tracker over the next chunk of the stream. Only record headers
+/// are read; record bodies are skipped by length.
+/// @param tracker Tracker, updated in place (zero-initialized to start)
+/// @param data Chunk bytes
+/// @param length Length of data
+/// @return 1 if the chunk starts and ends on a record boundary and holds only
+///         complete TLS application data records (17 03 03), 0 otherwise
+int vision_record_tracker_feed(vision_record_tracker *tracker,
+                               const uint8_t *data, size_t length);
+
+/// Search for the TLS 1.3 supported_versions extension (00 2b 00 02 03 04)
+/// in a ServerHello that may arrive over several reads
+/// @param matched Pattern bytes matched at the end of the previous read,
+///                updated in place (0 to start)
+/// @param data ServerHello bytes
+/// @param length Length of data
+/// @return 1 if the extension completes within data, 0 otherwise
+int vision_find_tls13_version(uint8_t *matched, const uint8_t *data, size_t length);
+
+/// Buffered ChaCha20 keystream used for Vision padding bytes, seeded once per
+/// connection so frames don't need a kernel CSPRNG call each
+typedef struct {
+    uint32_t state[16];
+    uint8_t  block[64];
+    size_t   available;     // unread bytes at the end of block
+} vision_keystream;
+
+/// Seed a keystream (ChaCha20, 64-bit block counter from 0, zero nonce)
+/// @param ks Keystream to initialize
+/// @param seed 32-byte key, e.g. from SecRandomCopyBytes
+void vision_keystream_init(vision_keystream *ks, const uint8_t *seed);
+
+/// Fill a buffer with the next keystream bytes
+/// @param ks Keystream
+/// @param out Output buffer
+/// @param length Number of bytes to write
+void vision_keystream_fill(vision_keystream *ks, uint8_t *out, size_t length);
+
 #endif /* CVLESS_h */
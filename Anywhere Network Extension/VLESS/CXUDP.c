@@ -0,0 +1,122 @@
+//
+//  CXUDP.c
+//  Network Extension
+//
+//  XUDP GlobalID computation (Xray-core common/xudp/xudp.go).
+//
+
+#include "CXUDP.h"
+#include "../Crypto/blake3.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Source address as two words (IPv4 zero-padded) and a tag holding the
+/// port, the family and a valid bit, so a lookup is three integer compares
+typedef struct {
+    uint64_t addr[2];
+    uint32_t tag;
+    uint32_t last_used;
+    uint8_t  id[XUDP_GLOBAL_ID_LEN];
+} xudp_global_id_entry;
+
+#define ENTRY_IPV6  (1u << 16)
+#define ENTRY_VALID (1u << 17)
+
+struct xudp_global_id_cache {
+    /// Hasher right after blake3_hasher_init_keyed. Its CV stack is empty,
+    /// so copying everything before cv_stack clones it.
+    blake3_hasher keyed;
+    uint32_t clock;
+    xudp_global_id_entry entries[XUDP_GLOBAL_ID_CACHE_SIZE];
+};
+
+xudp_global_id_cache *xudp_global_id_cache_create(const uint8_t *key) {
+    xudp_global_id_cache *cache = calloc(1, sizeof(*cache));
+    if (!cache) return NULL;
+    blake3_hasher_init_keyed(&cache->keyed, key);
+    return cache;
+}
+
+void xudp_global_id_cache_free(xudp_global_id_cache *cache) {
+    free(cache);
+}
+
+static char *append_dec(char *p, unsigned int value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+static char *append_hex(char *p, unsigned int value) {
+    static const char hex[] = "0123456789abcdef";
+    int shift = 12;
+    while (shift > 0 && !(value >> shift)) shift -= 4;
+    for (; shift >= 0; shift -= 4) *p++ = hex[(value >> shift) & 0xF];
+    return p;
+}
+
+/// Formats "udp:host:port", returns its length
+static size_t format_source(char *buf, const uint8_t *addr, int is_ipv6, uint16_t port) {
+    char *p = buf;
+    memcpy(p, "udp:", 4);
+    p += 4;
+    if (is_ipv6) {
+        for (int i = 0; i < 16; i += 2) {
+            if (i) *p++ = ':';
+            p = append_hex(p, (unsigned int)addr[i] << 8 | addr[i + 1]);
+        }
+    } else {
+        for (int i = 0; i < 4; i++) {
+            if (i) *p++ = '.';
+            p = append_dec(p, addr[i]);
+        }
+    }
+    *p++ = ':';
+    p = append_dec(p, port);
+    return (size_t)(p - buf);
+}
+
+void xudp_global_id(xudp_global_id_cache *cache, const void *addr, int is_ipv6,
+                    uint16_t port, uint8_t *out) {
+    uint64_t key[2] = { 0, 0 };
+    memcpy(key, addr, is_ipv6 ? 16 : 4);
+    const uint32_t tag = ENTRY_VALID | (is_ipv6 ? ENTRY_IPV6 : 0) | port;
+    const uint32_t now = ++cache->clock;
+
+    xudp_global_id_entry *victim = &cache->entries[0];
+    for (int i = 0; i < XUDP_GLOBAL_ID_CACHE_SIZE; i++) {
+        xudp_global_id_entry *e = &cache->entries[i];
+        if (e->tag == tag && e->addr[0] == key[0] && e->addr[1] == key[1]) {
+            e->last_used = now;
+            memcpy(out, e->id, XUDP_GLOBAL_ID_LEN);
+            return;
+        }
+        // Evict an empty slot first, else the least recently used
+        // (ages are compared wrap-safe)
+        if (!(victim->tag & ENTRY_VALID)) continue;
+        if (!(e->tag & ENTRY_VALID) || now - e->last_used > now - victim->last_used) {
+            victim = e;
+        }
+    }
+
+    // "udp:" + 8 groups of 4 hex digits and 7 colons + ":65535"
+    char source[4 + 39 + 6];
+    size_t source_len = format_source(source, addr, is_ipv6, port);
+
+    blake3_hasher hasher;
+    memcpy(&hasher, &cache->keyed, offsetof(blake3_hasher, cv_stack));
+    blake3_hasher_update(&hasher, source, source_len);
+    blake3_hasher_finalize(&hasher, out, XUDP_GLOBAL_ID_LEN);
+
+    victim->addr[0] = key[0];
+    victim->addr[1] = key[1];
+    victim->tag = tag;
+    victim->last_used = now;
+    memcpy(victim->id, out, XUDP_GLOBAL_ID_LEN);
+}
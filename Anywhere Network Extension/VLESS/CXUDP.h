@@ -0,0 +1,44 @@
+//
+//  CXUDP.h
+//  Network Extension
+//
+//  XUDP GlobalID computation (Xray-core common/xudp/xudp.go).
+//
+
+#ifndef CXUDP_h
+#define CXUDP_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Length of an XUDP GlobalID in bytes
+#define XUDP_GLOBAL_ID_LEN 8
+
+/// Number of source addresses whose GlobalIDs are kept
+#define XUDP_GLOBAL_ID_CACHE_SIZE 32
+
+/// GlobalID generator: a BLAKE3 hasher keyed once with the process BaseKey,
+/// plus a small LRU cache of source address -> GlobalID.
+/// Not thread-safe; callers serialize access.
+typedef struct xudp_global_id_cache xudp_global_id_cache;
+
+/// Create a generator for the given key
+/// @param key 32-byte BLAKE3 key (Xray-core BaseKey)
+/// @return The generator, or NULL on allocation failure
+xudp_global_id_cache *xudp_global_id_cache_create(const uint8_t *key);
+
+/// Free a generator created by xudp_global_id_cache_create
+void xudp_global_id_cache_free(xudp_global_id_cache *cache);
+
+/// Compute the GlobalID of a UDP source: blake3-keyed("udp:host:port") with
+/// host formatted as LWIPStack.ipAddrToString does (dotted IPv4, or eight
+/// uncompressed lowercase hex groups for IPv6)
+/// @param cache Generator
+/// @param addr Source address bytes in network order (4 for IPv4, 16 for IPv6)
+/// @param is_ipv6 Nonzero if addr is IPv6
+/// @param port Source port (host byte order)
+/// @param out Output buffer (XUDP_GLOBAL_ID_LEN bytes)
+void xudp_global_id(xudp_global_id_cache *cache, const void *addr, int is_ipv6,
+                    uint16_t port, uint8_t *out);
+
+#endif /* CXUDP_h */
@@ -7,31 +7,85 @@
 #include "lwip/priv/tcp_priv.h"
 #include "lwip/udp.h"
 #include "lwip/timeouts.h"
+#include "lwip/sys.h"
 #include "lwip/ip.h"
 #include "lwip/ip_addr.h"
 
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef __APPLE__
 #include <os/log.h>
+#endif
 
+/* ========================================================================
+ *  Logging
+ *
+ *  Messages go to the registered lwip_log_fn if any, otherwise to os_log on
+ *  Apple platforms and stderr elsewhere.
+ * ======================================================================== */
+
+static lwip_log_fn s_log_fn = NULL;
+#ifdef __APPLE__
 static os_log_t s_log = NULL;
+#endif
+
+void lwip_bridge_set_log_fn(lwip_log_fn fn) { s_log_fn = fn; }
+
+static void bridge_log(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void bridge_log(int level, const char *fmt, ...) {
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+
+    if (s_log_fn) {
+        s_log_fn(level, msg);
+        return;
+    }
+#ifdef __APPLE__
+    if (!s_log) {
+        s_log = os_log_create("com.argsment.Anywhere.Network-Extension", "LWIP-Bridge");
+    }
+    os_log_type_t type = level == LWIP_LOG_ERROR ? OS_LOG_TYPE_ERROR
+                       : level == LWIP_LOG_INFO  ? OS_LOG_TYPE_INFO
+                       : OS_LOG_TYPE_DEBUG;
+    os_log_with_type(s_log, type, "%{public}s", msg);
+#else
+    if (level == LWIP_LOG_ERROR) {
+        fprintf(stderr, "%s\n", msg);
+    }
+#endif
+}
 
 /* ========================================================================
  *  Registered callbacks (set by Swift)
  * ======================================================================== */
 
 static lwip_output_fn     s_output_fn     = NULL;
+static lwip_output_iov_fn s_output_iov_fn = NULL;
+static lwip_output_batch_fn s_output_batch_fn = NULL;
 static lwip_tcp_accept_fn s_tcp_accept_fn = NULL;
 static lwip_tcp_recv_fn   s_tcp_recv_fn   = NULL;
+static lwip_tcp_recv_ref_fn s_tcp_recv_ref_fn = NULL;
 static lwip_tcp_sent_fn   s_tcp_sent_fn   = NULL;
 static lwip_tcp_err_fn    s_tcp_err_fn    = NULL;
 static lwip_udp_recv_fn   s_udp_recv_fn   = NULL;
+static lwip_timeout_fn    s_timeout_fn    = NULL;
 
 void lwip_bridge_set_output_fn(lwip_output_fn fn)     { s_output_fn = fn; }
+void lwip_bridge_set_output_iov_fn(lwip_output_iov_fn fn) { s_output_iov_fn = fn; }
+void lwip_bridge_set_output_batch_fn(lwip_output_batch_fn fn) { s_output_batch_fn = fn; }
 void lwip_bridge_set_tcp_accept_fn(lwip_tcp_accept_fn fn) { s_tcp_accept_fn = fn; }
 void lwip_bridge_set_tcp_recv_fn(lwip_tcp_recv_fn fn)   { s_tcp_recv_fn = fn; }
+void lwip_bridge_set_tcp_recv_ref_fn(lwip_tcp_recv_ref_fn fn) { s_tcp_recv_ref_fn = fn; }
 void lwip_bridge_set_tcp_sent_fn(lwip_tcp_sent_fn fn)   { s_tcp_sent_fn = fn; }
 void lwip_bridge_set_tcp_err_fn(lwip_tcp_err_fn fn)     { s_tcp_err_fn = fn; }
 void lwip_bridge_set_udp_recv_fn(lwip_udp_recv_fn fn)   { s_udp_recv_fn = fn; }
+void lwip_bridge_set_timeout_fn(lwip_timeout_fn fn)     { s_timeout_fn = fn; }
 
 /* ========================================================================
  *  Network interface
@@ -49,27 +103,203 @@ static struct udp_pcb *udp_listen_pcb_v6 = NULL;
 static uint16_t s_current_udp_dst_port = 0;
 static ip_addr_t s_current_udp_dst_ip;
 
+/* Zero-copy ingest: wrap caller packets in PBUF_REF instead of copying them
+ * into PBUF_POOL. lwIP never writes to them (tcp_input converts a copy of the
+ * header) and detaches the data (see tcp_seg_copy / refused_data patches)
+ * only when it has to keep a segment beyond ip_input(). */
+static int s_zero_copy_input = 0;
+
+
+/* ========================================================================
+ *  Output batching
+ *
+ *  Packets emitted while a bridge entry point runs (packet input, timers,
+ *  TCP/UDP operations) are queued here by reference: the pbuf chain is kept
+ *  with pbuf_ref() and described as iovecs, nothing is copied. When the
+ *  outermost entry point returns, the queue is handed to Swift in one
+ *  lwip_output_batch_fn call, so a burst of segments becomes a single
+ *  writePackets, and the pbufs are released afterwards. A queued TCP segment
+ *  has ref > 1, so tcp_output_segment_busy() holds off retransmitting it in
+ *  the meantime. With a non-zero flush latency the queue may also be held
+ *  across entry points, bounded by an lwIP timeout.
+ * ======================================================================== */
+
+#define BRIDGE_OUTPUT_BATCH_LIMIT       256
+#define BRIDGE_OUTPUT_BATCH_DEFAULT     64
+
+/* Maximum pbuf chain length handed out as an iovec array; longer chains are
+ * flattened. Copied TCP segments are usually a single pbuf; segments written
+ * with lwip_bridge_tcp_write_ref() are a header pbuf plus referenced payload. */
+#define BRIDGE_MAX_IOV 16
+
+static struct pbuf *s_out_pbufs[BRIDGE_OUTPUT_BATCH_LIMIT];
+static struct iovec s_out_iov[BRIDGE_OUTPUT_BATCH_LIMIT * BRIDGE_MAX_IOV];
+static int      s_out_iovcnt[BRIDGE_OUTPUT_BATCH_LIMIT];
+static int      s_out_iov_used = 0;
+static int      s_out_is_ipv6[BRIDGE_OUTPUT_BATCH_LIMIT];
+static int      s_out_count = 0;
+static int      s_out_max_packets = BRIDGE_OUTPUT_BATCH_DEFAULT;
+static u32_t    s_out_latency_ms = 0;
+static u32_t    s_out_first_ms = 0;
+static int      s_out_timer_armed = 0;
+static int      s_out_depth = 0;
+
+static void output_flush_timeout(void *arg);
+static void timeout_notify(void);
+static void write_ref_release_pending(void);
+
+static void output_flush(void) {
+    if (s_out_timer_armed) {
+        sys_untimeout(output_flush_timeout, NULL);
+        s_out_timer_armed = 0;
+    }
+    if (s_out_count == 0) return;
+
+    if (s_output_batch_fn) {
+        s_output_batch_fn(s_out_iov, s_out_iovcnt, s_out_is_ipv6, s_out_count);
+    }
+    for (int i = 0; i < s_out_count; i++) {
+        pbuf_free(s_out_pbufs[i]);
+    }
+    s_out_count = 0;
+    s_out_iov_used = 0;
+
+    /* Queued iovecs may have pointed into write_ref memory */
+    write_ref_release_pending();
+}
+
+static void output_flush_timeout(void *arg) {
+    (void)arg;
+    s_out_timer_armed = 0;
+    output_flush();
+}
+
+/* Describes a pbuf chain as iovecs; returns the count, or -1 if the chain
+ * has more than BRIDGE_MAX_IOV non-empty segments. */
+static int pbuf_to_iov(struct pbuf *p, struct iovec *iov) {
+    int iovcnt = 0;
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        if (q->len == 0) continue;
+        if (iovcnt == BRIDGE_MAX_IOV) return -1;
+        iov[iovcnt].iov_base = q->payload;
+        iov[iovcnt].iov_len = q->len;
+        iovcnt++;
+    }
+    return iovcnt;
+}
+
+/* Queues a pbuf chain by reference. */
+static void output_enqueue(struct pbuf *p, int is_ipv6) {
+    struct iovec *iov = &s_out_iov[s_out_iov_used];
+    int iovcnt = pbuf_to_iov(p, iov);
+    if (iovcnt < 0) {
+        /* Chain too long for the iovec array: queue a flat copy */
+        struct pbuf *flat = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+        if (!flat) {
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] output: pbuf_clone failed for %u bytes", p->tot_len);
+            return;
+        }
+        p = flat;
+        iovcnt = pbuf_to_iov(p, iov);
+    } else {
+        pbuf_ref(p);
+    }
+
+    if (s_out_count == 0) {
+        s_out_first_ms = sys_now();
+    }
+    s_out_pbufs[s_out_count] = p;
+    s_out_iovcnt[s_out_count] = iovcnt;
+    s_out_is_ipv6[s_out_count] = is_ipv6;
+    s_out_iov_used += iovcnt;
+    s_out_count++;
+
+    if (s_out_count >= s_out_max_packets) {
+        output_flush();
+    }
+}
+
+/* Entry points that may emit packets bracket their work with these so the
+ * queue is flushed once, when the outermost call returns. */
+static void output_scope_begin(void) {
+    s_out_depth++;
+}
+
+static void output_scope_end(void) {
+    if (--s_out_depth > 0) return;
+    if (s_out_count > 0) {
+        u32_t elapsed = sys_now() - s_out_first_ms;
+        if (s_out_latency_ms == 0 || elapsed >= s_out_latency_ms) {
+            output_flush();
+        } else if (!s_out_timer_armed) {
+            sys_timeout(s_out_latency_ms - elapsed, output_flush_timeout, NULL);
+            s_out_timer_armed = 1;
+        }
+    }
+    /* The call may have started TCP timers or held output */
+    timeout_notify();
+}
+void lwip_bridge_set_output_batching(int max_packets, uint32_t flush_latency_ms) {
+    if (max_packets < 1) max_packets = 1;
+    if (max_packets > BRIDGE_OUTPUT_BATCH_LIMIT) max_packets = BRIDGE_OUTPUT_BATCH_LIMIT;
+    s_out_max_packets = max_packets;
+    s_out_latency_ms = flush_latency_ms;
+    if (s_out_count >= s_out_max_packets) {
+        output_flush();
+    }
+}
+
+void lwip_bridge_flush_output(void) {
+    output_flush();
+}
 
 /* ========================================================================
  *  Netif output callback
  * ======================================================================== */
 
-static err_t netif_output_ip4(struct netif *netif, struct pbuf *p,
-                               const ip4_addr_t *ipaddr) {
-    (void)netif; (void)ipaddr;
-    if (s_output_fn && p) {
-        if (p->next != NULL) {
-            void *buf = mem_malloc(p->tot_len);
-            if (buf) {
-                pbuf_copy_partial(p, buf, p->tot_len, 0);
-                s_output_fn(buf, p->tot_len, 0);
-                mem_free(buf);
+static void netif_output_pbuf(struct pbuf *p, int is_ipv6) {
+    if (s_output_batch_fn) {
+        output_enqueue(p, is_ipv6);
+        return;
+    }
+
+    if (s_output_iov_fn) {
+        struct iovec iov[BRIDGE_MAX_IOV];
+        int iovcnt = pbuf_to_iov(p, iov);
+        if (iovcnt >= 0) {
+            s_output_iov_fn(iov, iovcnt, is_ipv6);
+            return;
+        }
+        /* Chain too long for the iovec array: fall through and flatten */
+    }
+
+    if (p->next != NULL) {
+        void *buf = mem_malloc(p->tot_len);
+        if (buf) {
+            pbuf_copy_partial(p, buf, p->tot_len, 0);
+            if (s_output_iov_fn) {
+                struct iovec flat = { .iov_base = buf, .iov_len = p->tot_len };
+                s_output_iov_fn(&flat, 1, is_ipv6);
             } else {
-                os_log_error(s_log, "[Bridge] netif_output_ip4: mem_malloc failed for %u bytes", p->tot_len);
+                s_output_fn(buf, p->tot_len, is_ipv6);
             }
+            mem_free(buf);
         } else {
-            s_output_fn(p->payload, p->tot_len, 0);
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] netif_output: mem_malloc failed for %u bytes (ipv6=%d)", p->tot_len, is_ipv6);
         }
+    } else if (s_output_iov_fn) {
+        struct iovec single = { .iov_base = p->payload, .iov_len = p->len };
+        s_output_iov_fn(&single, 1, is_ipv6);
+    } else {
+        s_output_fn(p->payload, p->tot_len, is_ipv6);
+    }
+}
+
+static err_t netif_output_ip4(struct netif *netif, struct pbuf *p,
+                               const ip4_addr_t *ipaddr) {
+    (void)netif; (void)ipaddr;
+    if ((s_output_fn || s_output_iov_fn || s_output_batch_fn) && p) {
+        netif_output_pbuf(p, 0);
     }
     return ERR_OK;
 }
@@ -77,19 +307,8 @@ static err_t netif_output_ip4(struct netif *netif, struct pbuf *p,
 static err_t netif_output_ip6(struct netif *netif, struct pbuf *p,
                                const ip6_addr_t *ipaddr) {
     (void)netif; (void)ipaddr;
-    if (s_output_fn && p) {
-        if (p->next != NULL) {
-            void *buf = mem_malloc(p->tot_len);
-            if (buf) {
-                pbuf_copy_partial(p, buf, p->tot_len, 0);
-                s_output_fn(buf, p->tot_len, 1);
-                mem_free(buf);
-            } else {
-                os_log_error(s_log, "[Bridge] netif_output_ip6: mem_malloc failed for %u bytes", p->tot_len);
-            }
-        } else {
-            s_output_fn(p->payload, p->tot_len, 1);
-        }
+    if ((s_output_fn || s_output_iov_fn || s_output_batch_fn) && p) {
+        netif_output_pbuf(p, 1);
     }
     return ERR_OK;
 }
@@ -127,7 +346,7 @@ static void  tcp_err_cb(void *arg, err_t err);
 static err_t tcp_accept_cb(void *arg, struct tcp_pcb *newpcb, err_t err) {
     (void)arg; (void)err;
     if (!s_tcp_accept_fn || !newpcb) {
-        os_log_error(s_log, "[Bridge] tcp_accept_cb: no accept fn or no pcb");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_accept_cb: no accept fn or no pcb");
         return ERR_ABRT;
     }
 
@@ -140,7 +359,7 @@ static err_t tcp_accept_cb(void *arg, struct tcp_pcb *newpcb, err_t err) {
                                   dst_bytes, newpcb->local_port,
                                   is_ipv6, newpcb);
     if (!conn) {
-        os_log_error(s_log, "[Bridge] tcp_accept_cb: Swift returned NULL conn, aborting");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_accept_cb: Swift returned NULL conn, aborting");
         tcp_abort(newpcb);
         return ERR_ABRT;
     }
@@ -153,10 +372,83 @@ static err_t tcp_accept_cb(void *arg, struct tcp_pcb *newpcb, err_t err) {
     return ERR_OK;
 }
 
+/* ========================================================================
+ *  Zero-copy TCP receive
+ *
+ *  With a lwip_tcp_recv_ref_fn registered, received pbuf chains are handed to
+ *  Swift by reference and freed by lwip_bridge_pbuf_release() once the data
+ *  has been forwarded. Held bytes are capped so that data waiting on a slow
+ *  proxy connection cannot starve lwIP of pbufs; above the cap delivery falls
+ *  back to the copying lwip_tcp_recv_fn path.
+ * ======================================================================== */
+
+#define BRIDGE_RECV_REF_MAX_BYTES   (MEM_SIZE / 2)
+
+struct bridge_pbuf_handle {
+    struct pbuf *p;
+    u32_t generation;
+};
+
+/* Bumped on shutdown: lwip_init() resets the heap and pools, so handles that
+ * outlive a stack restart must not be passed to pbuf_free(). */
+static u32_t s_bridge_generation = 0;
+static size_t s_recv_ref_bytes = 0;
+
+/* Returns 1 if ownership of p was transferred to Swift, 0 to fall back to copying. */
+static int tcp_recv_deliver_ref(void *conn, struct pbuf *p) {
+    if (s_recv_ref_bytes + p->tot_len > BRIDGE_RECV_REF_MAX_BYTES) {
+        return 0;
+    }
+
+    int needs_copy = 0;
+    int nsegs = 0;
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        if (PBUF_NEEDS_COPY(q)) needs_copy = 1;
+        nsegs++;
+    }
+
+    struct bridge_pbuf_handle *handle = (struct bridge_pbuf_handle *)malloc(sizeof(*handle));
+    if (!handle) {
+        return 0;
+    }
+
+    /* Zero-copy input buffers are only valid during ip_input(); long chains
+     * are flattened so that they fit the iovec array. */
+    if (needs_copy || nsegs > BRIDGE_MAX_IOV) {
+        struct pbuf *q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+        if (!q) {
+            free(handle);
+            return 0;
+        }
+        pbuf_free(p);
+        p = q;
+    }
+
+    struct iovec iov[BRIDGE_MAX_IOV];
+    int iovcnt = pbuf_to_iov(p, iov);
+
+    handle->p = p;
+    handle->generation = s_bridge_generation;
+    s_recv_ref_bytes += p->tot_len;
+
+    s_tcp_recv_ref_fn(conn, handle, iov, iovcnt, p->tot_len);
+    return 1;
+}
+
+void lwip_bridge_pbuf_release(void *handle) {
+    struct bridge_pbuf_handle *h = (struct bridge_pbuf_handle *)handle;
+    if (!h) return;
+    if (h->generation == s_bridge_generation) {
+        s_recv_ref_bytes -= h->p->tot_len;
+        pbuf_free(h->p);
+    }
+    free(h);
+}
+
 static err_t tcp_recv_cb(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
-    (void)err;
+    (void)tpcb; (void)err;
     if (!arg) {
-        os_log_error(s_log, "[Bridge] tcp_recv_cb: arg is NULL, aborting");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_recv_cb: arg is NULL, aborting");
         if (p) pbuf_free(p);
         return ERR_ABRT;
     }
@@ -169,6 +461,10 @@ static err_t tcp_recv_cb(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t
         return ERR_OK;
     }
 
+    if (s_tcp_recv_ref_fn && tcp_recv_deliver_ref(arg, p)) {
+        return ERR_OK;
+    }
+
     if (s_tcp_recv_fn) {
         if (p->next != NULL) {
             void *buf = mem_malloc(p->tot_len);
@@ -177,7 +473,7 @@ static err_t tcp_recv_cb(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t
                 s_tcp_recv_fn(arg, buf, p->tot_len);
                 mem_free(buf);
             } else {
-                os_log_error(s_log, "[Bridge] tcp_recv_cb: mem_malloc failed for %u bytes", p->tot_len);
+                bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_recv_cb: mem_malloc failed for %u bytes", p->tot_len);
             }
         } else {
             s_tcp_recv_fn(arg, p->payload, p->tot_len);
@@ -188,8 +484,93 @@ static err_t tcp_recv_cb(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t
     return ERR_OK;
 }
 
+/* ========================================================================
+ *  Zero-copy TCP send
+ *
+ *  lwip_bridge_tcp_write_ref() queues caller memory without copying. Each
+ *  write records the sequence number just past its last byte; the caller's
+ *  release callback runs once lastack reaches it, or when the PCB is freed,
+ *  and never before batched output that may point at the data is flushed.
+ *  The per-PCB queue hangs off a TCP ext arg so that it outlives tcp_close()
+ *  while the remaining data drains.
+ * ======================================================================== */
+
+struct bridge_write_ref {
+    struct bridge_write_ref *next;
+    u32_t end_seq;
+    lwip_tcp_write_release_fn release;
+    void *ctx;
+};
+
+struct bridge_write_queue {
+    struct bridge_write_ref *head;
+    struct bridge_write_ref *tail;
+};
+
+static u8_t s_write_ref_ext_id;
+static int  s_write_ref_ext_id_allocated = 0;
+
+/* Writes whose data is acked or whose PCB is gone, but which may still be
+ * described by iovecs in the output queue: pbuf_ref() on a PBUF_ROM chain
+ * keeps the pbufs, not the memory they point to. Released after the next
+ * output_flush(). */
+static struct bridge_write_queue s_write_ref_pending;
+
+static void write_ref_release(struct bridge_write_ref *w) {
+    if (s_out_count == 0) {
+        w->release(w->ctx);
+        free(w);
+        return;
+    }
+    w->next = NULL;
+    if (s_write_ref_pending.tail) {
+        s_write_ref_pending.tail->next = w;
+    } else {
+        s_write_ref_pending.head = w;
+    }
+    s_write_ref_pending.tail = w;
+}
+
+static void write_ref_release_pending(void) {
+    while (s_write_ref_pending.head) {
+        struct bridge_write_ref *w = s_write_ref_pending.head;
+        s_write_ref_pending.head = w->next;
+        w->release(w->ctx);
+        free(w);
+    }
+    s_write_ref_pending.tail = NULL;
+}
+
+static void write_ref_release_acked(struct tcp_pcb *tpcb) {
+    struct bridge_write_queue *q = (struct bridge_write_queue *)tcp_ext_arg_get(tpcb, s_write_ref_ext_id);
+    if (!q) return;
+    while (q->head && TCP_SEQ_GEQ(tpcb->lastack, q->head->end_seq)) {
+        struct bridge_write_ref *w = q->head;
+        q->head = w->next;
+        write_ref_release(w);
+    }
+    if (!q->head) q->tail = NULL;
+}
+
+static void write_ref_destroyed(u8_t id, void *data) {
+    (void)id;
+    struct bridge_write_queue *q = (struct bridge_write_queue *)data;
+    if (!q) return;
+    while (q->head) {
+        struct bridge_write_ref *w = q->head;
+        q->head = w->next;
+        write_ref_release(w);
+    }
+    free(q);
+}
+
+static const struct tcp_ext_arg_callbacks s_write_ref_callbacks = {
+    write_ref_destroyed,
+    NULL
+};
+
 static err_t tcp_sent_cb(void *arg, struct tcp_pcb *tpcb, u16_t len) {
-    (void)tpcb;
+    write_ref_release_acked(tpcb);
     if (arg && s_tcp_sent_fn) {
         s_tcp_sent_fn(arg, len);
     }
@@ -229,7 +610,7 @@ static void udp_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
                           is_ipv6, buf, p->tot_len);
             mem_free(buf);
         } else {
-            os_log_error(s_log, "[Bridge] udp_recv_cb: mem_malloc failed for %u bytes", p->tot_len);
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] udp_recv_cb: mem_malloc failed for %u bytes", p->tot_len);
         }
     } else {
         s_udp_recv_fn(src_bytes, port,
@@ -245,10 +626,14 @@ static void udp_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p,
  * ======================================================================== */
 
 void lwip_bridge_init(void) {
-    s_log = os_log_create("com.argsment.Anywhere.Network-Extension", "LWIP-Bridge");
-
     lwip_init();
 
+    /* Ext arg ids are never returned and are not reset by lwip_init() */
+    if (!s_write_ref_ext_id_allocated) {
+        s_write_ref_ext_id = tcp_ext_arg_alloc_id();
+        s_write_ref_ext_id_allocated = 1;
+    }
+
     /* Add TUN netif with 0.0.0.0/0 (catch-all for IPv4) */
     ip4_addr_t ipaddr, netmask, gw;
     IP4_ADDR(&ipaddr, 0, 0, 0, 0);
@@ -277,10 +662,10 @@ void lwip_bridge_init(void) {
             tcp_listen_pcb_v4->local_port = 0;
             tcp_accept(tcp_listen_pcb_v4, tcp_accept_cb);
         } else {
-            os_log_error(s_log, "[Bridge] TCP v4 tcp_listen() failed!");
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] TCP v4 tcp_listen() failed!");
         }
     } else {
-        os_log_error(s_log, "[Bridge] TCP v4 tcp_new() failed!");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] TCP v4 tcp_new() failed!");
     }
 
     /* IPv6 TCP listener on port 0 (wildcard) */
@@ -292,10 +677,10 @@ void lwip_bridge_init(void) {
             tcp_listen_pcb_v6->local_port = 0;
             tcp_accept(tcp_listen_pcb_v6, tcp_accept_cb);
         } else {
-            os_log_error(s_log, "[Bridge] TCP v6 tcp_listen() failed!");
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] TCP v6 tcp_listen() failed!");
         }
     } else {
-        os_log_error(s_log, "[Bridge] TCP v6 tcp_new_ip_type() failed!");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] TCP v6 tcp_new_ip_type() failed!");
     }
 
     /* --- UDP catch-all listeners --- */
@@ -307,7 +692,7 @@ void lwip_bridge_init(void) {
         udp_listen_pcb_v4->local_port = 0;
         udp_recv(udp_listen_pcb_v4, udp_recv_cb, NULL);
     } else {
-        os_log_error(s_log, "[Bridge] UDP v4 udp_new() failed!");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] UDP v4 udp_new() failed!");
     }
 
     /* IPv6 UDP listener on port 0 (wildcard) */
@@ -317,12 +702,14 @@ void lwip_bridge_init(void) {
         udp_listen_pcb_v6->local_port = 0;
         udp_recv(udp_listen_pcb_v6, udp_recv_cb, NULL);
     } else {
-        os_log_error(s_log, "[Bridge] UDP v6 udp_new_ip_type() failed!");
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] UDP v6 udp_new_ip_type() failed!");
     }
 
 }
 
 void lwip_bridge_shutdown(void) {
+    output_scope_begin();
+
     /* Abort all active TCP connections.
      * Keep callbacks intact so tcp_abort() fires the err callback, which
      * notifies the Swift LWIPTCPConnection (sets closed=true, cancels VLESS,
@@ -342,23 +729,36 @@ void lwip_bridge_shutdown(void) {
         tcp_free(pcb);
     }
 
+    /* Deliver the RSTs generated above before the netif goes away */
+    output_scope_end();
+    output_flush();
+
     if (tcp_listen_pcb_v4) { tcp_close(tcp_listen_pcb_v4); tcp_listen_pcb_v4 = NULL; }
     if (tcp_listen_pcb_v6) { tcp_close(tcp_listen_pcb_v6); tcp_listen_pcb_v6 = NULL; }
-    if (udp_listen_pcb_v4) { udp_remove(udp_listen_pcb_v4); udp_listen_pcb_v4 = NULL; }
-    if (udp_listen_pcb_v6) { udp_remove(udp_listen_pcb_v6); udp_listen_pcb_v6 = NULL; }
+    udp_listen_pcb_v4 = NULL;
+    udp_listen_pcb_v6 = NULL;
+    /* Listeners and any per-flow PCBs Swift has not released; udp_init()
+     * does not reset udp_pcbs */
+    while (udp_pcbs) udp_remove(udp_pcbs);
     netif_set_down(&tun_netif);
     netif_remove(&tun_netif);
+
+    /* Outstanding receive handles now belong to a dead heap */
+    s_bridge_generation++;
+    s_recv_ref_bytes = 0;
 }
 
 /* ========================================================================
  *  Packet Input
  * ======================================================================== */
 
-void lwip_bridge_input(const void *data, int len) {
-    if (!data || len <= 0) return;
+/* Parses the IP header for UDP destination capture, wraps or copies the packet
+ * into a pbuf and hands it to ip_input. Shared by the single and batched entry
+ * points. */
+static void bridge_input_packet(const uint8_t *pkt, int len) {
+    if (!pkt || len <= 0) return;
 
     /* Parse IP version for UDP destination capture */
-    const uint8_t *pkt = (const uint8_t *)data;
     uint8_t version = (pkt[0] >> 4) & 0x0F;
 
     if (version == 4 && len >= 20) {
@@ -384,21 +784,75 @@ void lwip_bridge_input(const void *data, int len) {
         return;
     }
 
-    struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_POOL);
-    if (!p) {
-        os_log_error(s_log, "[Bridge] input: pbuf_alloc failed for %d bytes", len);
-        return;
+    struct pbuf *p;
+    if (s_zero_copy_input) {
+        p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_REF);
+        if (!p) {
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] input: PBUF_REF alloc failed for %d bytes", len);
+            return;
+        }
+        p->payload = (void *)pkt;
+    } else {
+        p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_POOL);
+        if (!p) {
+            bridge_log(LWIP_LOG_ERROR, "[Bridge] input: pbuf_alloc failed for %d bytes", len);
+            return;
+        }
+        pbuf_take(p, pkt, (u16_t)len);
     }
 
-    pbuf_take(p, data, (u16_t)len);
-
     err_t input_err = tun_netif.input(p, &tun_netif);
     if (input_err != ERR_OK) {
-        os_log_error(s_log, "[Bridge] input: ip_input err=%d", (int)input_err);
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] input: ip_input err=%d", (int)input_err);
         pbuf_free(p);
     }
 }
 
+/* Flushes PCBs whose tcp_output was deferred by tcp_input during a batch. */
+static void flush_deferred_tcp_output(void) {
+    struct tcp_pcb *pcb = tcp_active_pcbs;
+    while (pcb != NULL) {
+        struct tcp_pcb *next = pcb->next;
+        if (pcb->flags & TF_OUTPUT_PEND) {
+            tcp_clear_flags(pcb, TF_OUTPUT_PEND);
+            tcp_output(pcb);
+        }
+        pcb = next;
+    }
+}
+
+void lwip_bridge_set_zero_copy_input(int enabled) {
+    s_zero_copy_input = enabled ? 1 : 0;
+}
+
+void lwip_bridge_input(const void *data, int len) {
+    output_scope_begin();
+    bridge_input_packet((const uint8_t *)data, len);
+    output_scope_end();
+}
+
+void lwip_bridge_input_batch(const void **pkts, const int *lens, int n) {
+    if (!pkts || !lens || n <= 0) return;
+    if (n == 1) {
+        lwip_bridge_input(pkts[0], lens[0]);
+        return;
+    }
+
+    output_scope_begin();
+
+    /* Segments for the same connection commonly arrive back to back (bulk
+     * upload ACK streams), so one tcp_output per PCB at the end of the batch
+     * replaces one per segment. */
+    tcp_input_defer_output = 1;
+    for (int i = 0; i < n; i++) {
+        bridge_input_packet((const uint8_t *)pkts[i], lens[i]);
+    }
+    tcp_input_defer_output = 0;
+
+    flush_deferred_tcp_output();
+    output_scope_end();
+}
+
 /* ========================================================================
  *  TCP Operations
  * ======================================================================== */
@@ -407,31 +861,70 @@ int lwip_bridge_tcp_write(void *pcb, const void *data, uint16_t len) {
     struct tcp_pcb *tpcb = (struct tcp_pcb *)pcb;
     err_t err = tcp_write(tpcb, data, len, TCP_WRITE_FLAG_COPY);
     if (err != ERR_OK) {
-        os_log_error(s_log, "[Bridge] tcp_write: err=%d len=%u sndbuf=%u",
-                     (int)err, len, tcp_sndbuf(tpcb));
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_write: err=%d len=%u sndbuf=%u",
+                   (int)err, len, tcp_sndbuf(tpcb));
     }
     return (int)err;
 }
 
+int lwip_bridge_tcp_write_ref(void *pcb, const void *data, uint16_t len,
+                              lwip_tcp_write_release_fn release_cb, void *ctx) {
+    struct tcp_pcb *tpcb = (struct tcp_pcb *)pcb;
+    struct bridge_write_queue *q = (struct bridge_write_queue *)tcp_ext_arg_get(tpcb, s_write_ref_ext_id);
+    if (!q) {
+        q = (struct bridge_write_queue *)calloc(1, sizeof(*q));
+        if (!q) return (int)ERR_MEM;
+        tcp_ext_arg_set(tpcb, s_write_ref_ext_id, q);
+        tcp_ext_arg_set_callbacks(tpcb, s_write_ref_ext_id, &s_write_ref_callbacks);
+    }
+
+    struct bridge_write_ref *w = (struct bridge_write_ref *)malloc(sizeof(*w));
+    if (!w) return (int)ERR_MEM;
+
+    /* Without TCP_WRITE_FLAG_COPY, tcp_write() chains PBUF_ROM pbufs that
+     * point at data; the memory must stay valid until it is acknowledged. */
+    err_t err = tcp_write(tpcb, data, len, 0);
+    if (err != ERR_OK) {
+        free(w);
+        return (int)err;
+    }
+
+    w->next = NULL;
+    w->end_seq = tpcb->snd_lbb;
+    w->release = release_cb;
+    w->ctx = ctx;
+    if (q->tail) q->tail->next = w; else q->head = w;
+    q->tail = w;
+    return (int)ERR_OK;
+}
+
 void lwip_bridge_tcp_output(void *pcb) {
+    output_scope_begin();
     tcp_output((struct tcp_pcb *)pcb);
+    output_scope_end();
 }
 
 void lwip_bridge_tcp_recved(void *pcb, uint16_t len) {
+    /* May emit a window update */
+    output_scope_begin();
     tcp_recved((struct tcp_pcb *)pcb, len);
+    output_scope_end();
 }
 
 void lwip_bridge_tcp_close(void *pcb) {
     struct tcp_pcb *tpcb = (struct tcp_pcb *)pcb;
     tcp_arg(tpcb, NULL);
     tcp_recv(tpcb, NULL);
-    tcp_sent(tpcb, NULL);
+    /* tcp_sent_cb stays installed: it releases referenced writes as the
+     * remaining data is acknowledged, and ignores the NULL arg otherwise. */
     tcp_err(tpcb, NULL);
+    output_scope_begin();
     err_t err = tcp_close(tpcb);
     if (err != ERR_OK) {
-        os_log_error(s_log, "[Bridge] tcp_close failed (err=%d), falling back to abort", (int)err);
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] tcp_close failed (err=%d), falling back to abort", (int)err);
         tcp_abort(tpcb);
     }
+    output_scope_end();
 }
 
 void lwip_bridge_tcp_abort(void *pcb) {
@@ -440,7 +933,9 @@ void lwip_bridge_tcp_abort(void *pcb) {
     tcp_recv(tpcb, NULL);
     tcp_sent(tpcb, NULL);
     tcp_err(tpcb, NULL);
+    output_scope_begin();
     tcp_abort(tpcb);
+    output_scope_end();
 }
 
 int lwip_bridge_tcp_sndbuf(void *pcb) {
@@ -451,65 +946,140 @@ int lwip_bridge_tcp_sndbuf(void *pcb) {
  *  UDP Operations
  * ======================================================================== */
 
-void lwip_bridge_udp_sendto(const void *src_ip_bytes, uint16_t src_port,
-                             const void *dst_ip_bytes, uint16_t dst_port,
-                             int is_ipv6,
-                             const void *data, int len) {
-    if (!data || len <= 0) return;
-
-    /* Reconstruct ip_addr_t from raw bytes */
-    ip_addr_t src_addr, dst_addr;
+static void udp_addr_from_bytes(ip_addr_t *addr, const void *bytes, int is_ipv6) {
+    memset(addr, 0, sizeof(*addr));
     if (is_ipv6) {
-        memset(&src_addr, 0, sizeof(src_addr));
-        memset(&dst_addr, 0, sizeof(dst_addr));
-        memcpy(ip_2_ip6(&src_addr), src_ip_bytes, 16);
-        IP_SET_TYPE_VAL(src_addr, IPADDR_TYPE_V6);
-        memcpy(ip_2_ip6(&dst_addr), dst_ip_bytes, 16);
-        IP_SET_TYPE_VAL(dst_addr, IPADDR_TYPE_V6);
+        memcpy(ip_2_ip6(addr), bytes, 16);
+        IP_SET_TYPE_VAL(*addr, IPADDR_TYPE_V6);
     } else {
-        memset(&src_addr, 0, sizeof(src_addr));
-        memset(&dst_addr, 0, sizeof(dst_addr));
-        memcpy(ip_2_ip4(&src_addr), src_ip_bytes, 4);
-        IP_SET_TYPE_VAL(src_addr, IPADDR_TYPE_V4);
-        memcpy(ip_2_ip4(&dst_addr), dst_ip_bytes, 4);
-        IP_SET_TYPE_VAL(dst_addr, IPADDR_TYPE_V4);
+        memcpy(ip_2_ip4(addr), bytes, 4);
+        IP_SET_TYPE_VAL(*addr, IPADDR_TYPE_V4);
     }
+}
 
-    struct udp_pcb *pcb = udp_new_ip_type(is_ipv6 ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4);
+/* Each flow keeps one PCB connected from the remote server (local side) to
+ * the app (remote side). It is found by udp_input()'s hash index, so uplink
+ * datagrams of the flow skip the udp_pcbs walk, and by udp_sendto below, so
+ * replies skip the PCB setup. Swift drops it with lwip_bridge_udp_release. */
+static struct udp_pcb *udp_flow_pcb(const ip_addr_t *src_addr, uint16_t src_port,
+                                    const ip_addr_t *dst_addr, uint16_t dst_port,
+                                    int is_ipv6) {
+    struct udp_pcb *pcb = udp_pcb_hash_lookup(src_addr, src_port, dst_addr, dst_port);
+    if (pcb) return pcb;
+
+    pcb = udp_new_ip_type(is_ipv6 ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4);
     if (!pcb) {
-        os_log_error(s_log, "[Bridge] udp_sendto: udp_new_ip_type failed");
-        return;
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] udp_sendto: udp_new_ip_type failed");
+        return NULL;
     }
 
-    err_t bind_err = udp_bind(pcb, &src_addr, src_port);
-    if (bind_err != ERR_OK) {
-        os_log_error(s_log, "[Bridge] udp_sendto: udp_bind failed err=%d", (int)bind_err);
+    /* Bound by hand: flows to the same server addr:port share the local
+     * side, which udp_bind() rejects without SO_REUSE */
+    ip_addr_copy(pcb->local_ip, *src_addr);
+    pcb->local_port = src_port;
+    udp_recv(pcb, udp_recv_cb, NULL);
+
+    err_t err = udp_connect(pcb, dst_addr, dst_port);
+    if (err != ERR_OK) {
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] udp_sendto: udp_connect failed err=%d", (int)err);
         udp_remove(pcb);
-        return;
+        return NULL;
     }
+    return pcb;
+}
+
+void lwip_bridge_udp_sendto(const void *src_ip_bytes, uint16_t src_port,
+                             const void *dst_ip_bytes, uint16_t dst_port,
+                             int is_ipv6,
+                             const void *data, int len) {
+    if (!data || len <= 0) return;
+
+    /* Reconstruct ip_addr_t from raw bytes */
+    ip_addr_t src_addr, dst_addr;
+    udp_addr_from_bytes(&src_addr, src_ip_bytes, is_ipv6);
+    udp_addr_from_bytes(&dst_addr, dst_ip_bytes, is_ipv6);
+
+    struct udp_pcb *pcb = udp_flow_pcb(&src_addr, src_port, &dst_addr, dst_port, is_ipv6);
+    if (!pcb) return;
 
     struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)len, PBUF_RAM);
     if (!p) {
-        os_log_error(s_log, "[Bridge] udp_sendto: pbuf_alloc failed for %d bytes", len);
-        udp_remove(pcb);
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] udp_sendto: pbuf_alloc failed for %d bytes", len);
         return;
     }
     memcpy(p->payload, data, len);
 
     /* Use udp_sendto_if_src to bypass routing (lwIP can't route arbitrary IPs
      * through our TUN netif without a full routing table) */
+    output_scope_begin();
     err_t send_err = udp_sendto_if_src(pcb, p, &dst_addr, dst_port, &tun_netif, &src_addr);
+    output_scope_end();
     if (send_err != ERR_OK) {
-        os_log_error(s_log, "[Bridge] udp_sendto: failed err=%d is_ipv6=%d", (int)send_err, is_ipv6);
+        bridge_log(LWIP_LOG_ERROR, "[Bridge] udp_sendto: failed err=%d is_ipv6=%d", (int)send_err, is_ipv6);
     }
     pbuf_free(p);
-    udp_remove(pcb);
+}
+
+void lwip_bridge_udp_release(const void *src_ip_bytes, uint16_t src_port,
+                             const void *dst_ip_bytes, uint16_t dst_port,
+                             int is_ipv6) {
+    ip_addr_t src_addr, dst_addr;
+    udp_addr_from_bytes(&src_addr, src_ip_bytes, is_ipv6);
+    udp_addr_from_bytes(&dst_addr, dst_ip_bytes, is_ipv6);
+
+    struct udp_pcb *pcb = udp_pcb_hash_lookup(&src_addr, src_port, &dst_addr, dst_port);
+    if (pcb) udp_remove(pcb);
 }
 
 /* ========================================================================
  *  Timer
  * ======================================================================== */
 
-void lwip_bridge_check_timeouts(void) {
+/* Deadline (sys_now() ms) of the next timeout as last reported to Swift,
+ * either as the check_timeouts return value or through s_timeout_fn. */
+static u32_t s_timeout_deadline = 0;
+static int   s_timeout_deadline_valid = 0;
+static int   s_checking_timeouts = 0;
+
+/* lwIP also keeps nd6_tmr cycling, but with static addresses on a
+ * point-to-point netif it has nothing to do; overdue cyclic timers are caught
+ * up by the next sys_check_timeouts(). Only TCP and held output need a timer. */
+static u32_t next_timeout_delay(void) {
+    if (tcp_active_pcbs == NULL && tcp_tw_pcbs == NULL && !s_out_timer_armed) {
+        return LWIP_BRIDGE_TIMEOUT_NONE;
+    }
+    u32_t delay = sys_timeouts_sleeptime();
+    return delay == SYS_TIMEOUTS_SLEEPTIME_INFINITE ? LWIP_BRIDGE_TIMEOUT_NONE : delay;
+}
+
+/* Tells Swift when the next timeout is earlier than the reported one, or
+ * when there is one at all after the stack went idle */
+static void timeout_notify(void) {
+    if (!s_timeout_fn || s_checking_timeouts) return;
+    u32_t delay = next_timeout_delay();
+    if (delay == LWIP_BRIDGE_TIMEOUT_NONE) return;
+
+    u32_t now = sys_now();
+    u32_t deadline = now + delay;
+    if (s_timeout_deadline_valid &&
+        (s32_t)(s_timeout_deadline - now) >= 0 &&
+        (s32_t)(deadline - s_timeout_deadline) >= 0) {
+        return;
+    }
+    s_timeout_deadline = deadline;
+    s_timeout_deadline_valid = 1;
+    s_timeout_fn(delay);
+}
+
+uint32_t lwip_bridge_check_timeouts(void) {
+    s_checking_timeouts = 1;
+    output_scope_begin();
     sys_check_timeouts();
+    output_scope_end();
+    s_checking_timeouts = 0;
+
+    u32_t delay = next_timeout_delay();
+    s_timeout_deadline_valid = delay != LWIP_BRIDGE_TIMEOUT_NONE;
+    s_timeout_deadline = sys_now() + delay;
+    return delay;
 }
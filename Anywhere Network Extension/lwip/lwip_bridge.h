@@ -3,12 +3,28 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 /* --- Callback types (implemented in Swift with @convention(c)) --- */
 
 /* Netif output: lwIP wants to send an IP packet back to the TUN interface */
 typedef void (*lwip_output_fn)(const void *data, int len, int is_ipv6);
 
+/* Scatter-gather netif output: the packet is described by iovcnt segments
+ * (one per pbuf in the chain) that are only valid for the duration of the
+ * call. Takes precedence over lwip_output_fn when registered. This is the
+ * unbatched form of lwip_output_batch_fn, which hands out the same segments
+ * for a whole batch. */
+typedef void (*lwip_output_iov_fn)(const struct iovec *iov, int iovcnt, int is_ipv6);
+
+/* Batched netif output: count packets emitted during one bridge call (packet
+ * input, timer tick, TCP/UDP operation), in scatter-gather form. Packet i is
+ * the next iovcnt[i] entries of iov (one per pbuf in its chain); the segments
+ * are only valid for the duration of the call.
+ * Takes precedence over the per-packet callbacks when registered. */
+typedef void (*lwip_output_batch_fn)(const struct iovec *iov, const int *iovcnt,
+                                     const int *is_ipv6, int count);
+
 /* TCP accept: new TCP connection accepted (returns opaque pointer stored as PCB arg)
  * IP addresses are raw bytes: 4 bytes for IPv4, 16 bytes for IPv6 */
 typedef void *(*lwip_tcp_accept_fn)(const void *src_ip, uint16_t src_port,
@@ -18,6 +34,18 @@ typedef void *(*lwip_tcp_accept_fn)(const void *src_ip, uint16_t src_port,
 /* TCP recv: data received on a TCP connection */
 typedef void (*lwip_tcp_recv_fn)(void *conn, const void *data, int len);
 
+/* TCP recv (zero-copy): the received pbuf chain is described by iovcnt
+ * segments totalling len bytes. The memory stays valid until the callee
+ * passes handle to lwip_bridge_pbuf_release() (on the lwIP queue). A FIN is
+ * still reported through lwip_tcp_recv_fn with NULL data. */
+typedef void (*lwip_tcp_recv_ref_fn)(void *conn, void *handle,
+                                     const struct iovec *iov, int iovcnt, int len);
+
+/* Release callback for lwip_bridge_tcp_write_ref(): the referenced bytes
+ * have been acknowledged (or the connection is gone) and no batched output
+ * still points at them. Runs on the lwIP queue. */
+typedef void (*lwip_tcp_write_release_fn)(void *ctx);
+
 /* TCP sent: send buffer space freed (bytes acknowledged) */
 typedef void (*lwip_tcp_sent_fn)(void *conn, uint16_t len);
 
@@ -30,25 +58,66 @@ typedef void (*lwip_udp_recv_fn)(const void *src_ip, uint16_t src_port,
                                   const void *dst_ip, uint16_t dst_port,
                                   int is_ipv6, const void *data, int len);
 
+/* Log sink: level is one of LWIP_LOG_*, message is NUL-terminated and only
+ * valid for the duration of the call. Without one, the bridge logs to os_log
+ * on Apple platforms and stderr elsewhere. */
+enum {
+    LWIP_LOG_ERROR = 0,
+    LWIP_LOG_INFO  = 1,
+    LWIP_LOG_DEBUG = 2,
+};
+typedef void (*lwip_log_fn)(int level, const char *message);
+
+/* Timeout: an lwIP timeout is now due in delay_ms, earlier than the delay
+ * last returned by lwip_bridge_check_timeouts() (or the stack was idle).
+ * The caller should arm its timer for it. */
+typedef void (*lwip_timeout_fn)(uint32_t delay_ms);
+
 /* --- Callback registration --- */
 void lwip_bridge_set_output_fn(lwip_output_fn fn);
+void lwip_bridge_set_output_iov_fn(lwip_output_iov_fn fn);
+void lwip_bridge_set_output_batch_fn(lwip_output_batch_fn fn);
+
+/* --- Output batching ---
+ * max_packets: flush as soon as this many packets are queued (1...256).
+ * flush_latency_ms: 0 flushes when each bridge call returns; otherwise the
+ * queue may be held across calls for up to this long. */
+void lwip_bridge_set_output_batching(int max_packets, uint32_t flush_latency_ms);
+void lwip_bridge_flush_output(void);
 void lwip_bridge_set_tcp_accept_fn(lwip_tcp_accept_fn fn);
 void lwip_bridge_set_tcp_recv_fn(lwip_tcp_recv_fn fn);
+void lwip_bridge_set_tcp_recv_ref_fn(lwip_tcp_recv_ref_fn fn);
 void lwip_bridge_set_tcp_sent_fn(lwip_tcp_sent_fn fn);
 void lwip_bridge_set_tcp_err_fn(lwip_tcp_err_fn fn);
 void lwip_bridge_set_udp_recv_fn(lwip_udp_recv_fn fn);
+void lwip_bridge_set_log_fn(lwip_log_fn fn);
+void lwip_bridge_set_timeout_fn(lwip_timeout_fn fn);
 
 /* --- Lifecycle --- */
 void lwip_bridge_init(void);
 void lwip_bridge_shutdown(void);
 
-/* --- Packet input (from TUN) --- */
+/* --- Packet input (from TUN) ---
+ * With zero-copy input enabled, packets are referenced rather than copied and
+ * must stay valid until the input call returns. They are only read: TCP
+ * headers are converted to host byte order in a copy, and data lwIP keeps
+ * past the call (out-of-order or refused segments) is detached first. */
+void lwip_bridge_set_zero_copy_input(int enabled);
 void lwip_bridge_input(const void *data, int len);
 
+/* Feeds a vector of n packets in one call. TCP output triggered by the input
+ * is coalesced and flushed once per connection at the end of the batch. */
+void lwip_bridge_input_batch(const void **pkts, const int *lens, int n);
+
 /* --- TCP operations (called from Swift on lwipQueue) --- */
 int  lwip_bridge_tcp_write(void *pcb, const void *data, uint16_t len);
+/* Queue data without copying. On success, data must stay valid until
+ * release_cb(ctx) is called; on failure release_cb is not called. */
+int  lwip_bridge_tcp_write_ref(void *pcb, const void *data, uint16_t len,
+                               lwip_tcp_write_release_fn release_cb, void *ctx);
 void lwip_bridge_tcp_output(void *pcb);
 void lwip_bridge_tcp_recved(void *pcb, uint16_t len);
+void lwip_bridge_pbuf_release(void *handle);
 void lwip_bridge_tcp_close(void *pcb);
 void lwip_bridge_tcp_abort(void *pcb);
 int  lwip_bridge_tcp_sndbuf(void *pcb);
@@ -59,8 +128,17 @@ void lwip_bridge_udp_sendto(const void *src_ip_bytes, uint16_t src_port,
                              const void *dst_ip_bytes, uint16_t dst_port,
                              int is_ipv6,
                              const void *data, int len);
+/* Drops the PCB that lwip_bridge_udp_sendto keeps per flow; same argument
+ * order as the sendto that created it. */
+void lwip_bridge_udp_release(const void *src_ip_bytes, uint16_t src_port,
+                             const void *dst_ip_bytes, uint16_t dst_port,
+                             int is_ipv6);
 
-/* --- Timer --- */
-void lwip_bridge_check_timeouts(void);
+/* --- Timer ---
+ * Runs the due lwIP timeouts and returns the delay in ms until the next one,
+ * or LWIP_BRIDGE_TIMEOUT_NONE when nothing needs a timer (no TCP PCB and no
+ * held output). Call again when that delay elapses or lwip_timeout_fn fires. */
+#define LWIP_BRIDGE_TIMEOUT_NONE 0xFFFFFFFFu
+uint32_t lwip_bridge_check_timeouts(void);
 
 #endif /* LWIP_BRIDGE_H */
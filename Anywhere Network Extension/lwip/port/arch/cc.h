@@ -16,7 +16,7 @@ typedef uint32_t    u32_t;
 typedef int32_t     s32_t;
 typedef uintptr_t   mem_ptr_t;
 
-/* --- Byte order: ARM64 iOS is little-endian --- */
+/* --- Byte order: ARM64 iOS and x86-64/ARM64 Linux are little-endian --- */
 #ifndef BYTE_ORDER
 #define BYTE_ORDER LITTLE_ENDIAN
 #endif
@@ -46,6 +46,11 @@ typedef uintptr_t   mem_ptr_t;
 #endif
 
 /* --- Random number generation --- */
+#ifdef __APPLE__
 #define LWIP_RAND() ((u32_t)arc4random())
+#else
+u32_t lwip_port_rand(void);     /* getrandom(), see sys_arch.c */
+#define LWIP_RAND() lwip_port_rand()
+#endif
 
 #endif /* CC_H */
@@ -41,7 +41,11 @@
 #define LWIP_CALLBACK_API               1
 
 /* --- Memory configuration (iOS NE ~15MB limit) --- */
+/* MEM_SIZE, PBUF_POOL_SIZE, TCP_WND and TCP_SND_BUF may be overridden from
+ * the compiler command line to compare configurations (see CMakeLists.txt). */
+#ifndef MEM_SIZE
 #define MEM_SIZE                        (512 * 1024)
+#endif
 #define MEM_ALIGNMENT                   4
 #define MEMP_OVERFLOW_CHECK             0
 #define MEMP_SANITY_CHECK               0
@@ -49,20 +53,40 @@
 /* --- Pool sizes --- */
 #define MEMP_NUM_TCP_PCB                128
 #define MEMP_NUM_TCP_PCB_LISTEN         2
-#define MEMP_NUM_UDP_PCB                4
+/* Two wildcard listeners plus one cached PCB per active UDP flow
+ * (LWIPStack.maxUDPFlows) */
+#define MEMP_NUM_UDP_PCB                256
 #define MEMP_NUM_TCP_SEG                512
-#define MEMP_NUM_PBUF                   64
+/* PBUF_REF/ROM headers: zero-copy TUN input and non-copying tcp_write */
+#define MEMP_NUM_PBUF                   1024
 #define MEMP_NUM_NETBUF                 0
 #define MEMP_NUM_NETCONN                0
+/* lwIP's cyclic timers plus the bridge's output flush timer
+ * (lwip_bridge_set_output_batching with a flush latency) */
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 1)
+/* Per-PCB queue of referenced writes (lwip_bridge_tcp_write_ref) */
+#define LWIP_TCP_PCB_NUM_EXT_ARGS       1
+/* 4-tuple hash demux in tcp_input() instead of walking the PCB lists */
+#define LWIP_TCP_PCB_HASH               1
+#define TCP_PCB_HASH_SIZE               256
+/* Same for connected UDP PCBs in udp_input() */
+#define LWIP_UDP_PCB_HASH               1
+#define UDP_PCB_HASH_SIZE               256
 
 /* --- Pbuf configuration --- */
+#ifndef PBUF_POOL_SIZE
 #define PBUF_POOL_SIZE                  256
+#endif
 #define PBUF_POOL_BUFSIZE               1500
 
 /* --- TCP configuration --- */
 #define TCP_MSS                         1360
+#ifndef TCP_WND
 #define TCP_WND                         (64 * TCP_MSS)
+#endif
+#ifndef TCP_SND_BUF
 #define TCP_SND_BUF                     (64 * TCP_MSS)
+#endif
 #define TCP_SND_QUEUELEN                (4 * TCP_SND_BUF / TCP_MSS)
 #define TCP_QUEUE_OOSEQ                 1
 #define TCP_OVERSIZE                    TCP_MSS
@@ -98,7 +122,8 @@
 #define IP_FRAG                         0
 
 /* --- Misc --- */
-#define LWIP_NETIF_TX_SINGLE_PBUF       1
+/* Chained TX pbufs allow non-copying tcp_write; netif output is scatter-gather */
+#define LWIP_NETIF_TX_SINGLE_PBUF       0
 #define LWIP_HAVE_LOOPIF                0
 #define LWIP_NETIF_LOOPBACK             0
 #define LWIP_RANDOMIZE_INITIAL_LOCAL_PORTS 1
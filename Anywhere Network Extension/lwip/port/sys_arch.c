@@ -1,4 +1,6 @@
 #include "lwip/sys.h"
+
+#ifdef __APPLE__
 #include <mach/mach_time.h>
 
 static mach_timebase_info_data_t timebase_info;
@@ -14,3 +16,25 @@ u32_t sys_now(void) {
     uint64_t nanos = ticks * timebase_info.numer / timebase_info.denom;
     return (u32_t)(nanos / 1000000ULL);
 }
+
+#else /* Linux */
+#include <errno.h>
+#include <time.h>
+#include <sys/random.h>
+
+u32_t sys_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u32_t)((uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL);
+}
+
+u32_t lwip_port_rand(void) {
+    /* Reads of up to 256 bytes from the urandom source are never short */
+    u32_t value = 0;
+    ssize_t n;
+    do {
+        n = getrandom(&value, sizeof(value), 0);
+    } while (n < 0 && errno == EINTR);
+    return value;
+}
+#endif
@@ -177,6 +177,11 @@ struct tcp_pcb *tcp_active_pcbs;
 /** List of all TCP PCBs in TIME-WAIT state */
 struct tcp_pcb *tcp_tw_pcbs;
 
+#if LWIP_TCP_PCB_HASH
+/** tun2socks patch: hash index over tcp_active_pcbs and tcp_tw_pcbs */
+static struct tcp_pcb *tcp_pcb_hash_table[TCP_PCB_HASH_SIZE];
+#endif /* LWIP_TCP_PCB_HASH */
+
 /** An array with all (non-temporary) PCB lists, mainly used for smaller code size */
 struct tcp_pcb **const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs,
          &tcp_active_pcbs, &tcp_tw_pcbs
@@ -203,8 +208,84 @@ tcp_init(void)
 #ifdef LWIP_RAND
   tcp_port = TCP_ENSURE_LOCAL_PORT_RANGE(LWIP_RAND());
 #endif /* LWIP_RAND */
+#if LWIP_TCP_PCB_HASH
+  memset(tcp_pcb_hash_table, 0, sizeof(tcp_pcb_hash_table));
+#endif /* LWIP_TCP_PCB_HASH */
+}
+
+#if LWIP_TCP_PCB_HASH
+/* tun2socks patch: 4-tuple hash index over tcp_active_pcbs and tcp_tw_pcbs.
+   Entries are added and removed by TCP_REG/TCP_RMV; the tuple of a PCB never
+   changes while it is on either list. */
+static u32_t
+tcp_pcb_hash(const ip_addr_t *remote_ip, u16_t remote_port,
+             const ip_addr_t *local_ip, u16_t local_port)
+{
+  u32_t h = ((u32_t)remote_port << 16) | local_port;
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    const u32_t *r = ip_2_ip6(remote_ip)->addr;
+    const u32_t *l = ip_2_ip6(local_ip)->addr;
+    h ^= r[0] ^ r[1] ^ r[2] ^ r[3];
+    h = (h << 7) | (h >> 25);
+    h ^= l[0] ^ l[1] ^ l[2] ^ l[3];
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4
+  if (IP_IS_V4(remote_ip)) {
+    h ^= ip4_addr_get_u32(ip_2_ip4(remote_ip));
+    h = (h << 7) | (h >> 25);
+    h ^= ip4_addr_get_u32(ip_2_ip4(local_ip));
+  }
+#endif /* LWIP_IPV4 */
+  /* murmur3 finalizer */
+  h ^= h >> 16;
+  h *= 0x85ebca6bUL;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35UL;
+  h ^= h >> 16;
+  return h & (TCP_PCB_HASH_SIZE - 1);
+}
+
+void
+tcp_pcb_hash_insert(struct tcp_pcb *pcb)
+{
+  u32_t idx = tcp_pcb_hash(&pcb->remote_ip, pcb->remote_port, &pcb->local_ip, pcb->local_port);
+  pcb->hash_next = tcp_pcb_hash_table[idx];
+  tcp_pcb_hash_table[idx] = pcb;
 }
 
+void
+tcp_pcb_hash_remove(struct tcp_pcb *pcb)
+{
+  u32_t idx = tcp_pcb_hash(&pcb->remote_ip, pcb->remote_port, &pcb->local_ip, pcb->local_port);
+  struct tcp_pcb **link;
+  for (link = &tcp_pcb_hash_table[idx]; *link != NULL; link = &(*link)->hash_next) {
+    if (*link == pcb) {
+      *link = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+
+struct tcp_pcb *
+tcp_pcb_hash_lookup(const ip_addr_t *remote_ip, u16_t remote_port,
+                    const ip_addr_t *local_ip, u16_t local_port)
+{
+  struct tcp_pcb *pcb = tcp_pcb_hash_table[tcp_pcb_hash(remote_ip, remote_port, local_ip, local_port)];
+  for (; pcb != NULL; pcb = pcb->hash_next) {
+    if (pcb->remote_port == remote_port &&
+        pcb->local_port == local_port &&
+        ip_addr_eq(&pcb->remote_ip, remote_ip) &&
+        ip_addr_eq(&pcb->local_ip, local_ip)) {
+      return pcb;
+    }
+  }
+  return NULL;
+}
+#endif /* LWIP_TCP_PCB_HASH */
+
 /** Free a tcp pcb */
 void
 tcp_free(struct tcp_pcb *pcb)
@@ -1388,6 +1469,8 @@ tcp_slowtmr_start:
       void *err_arg;
       enum tcp_state last_state;
       tcp_pcb_purge(pcb);
+      /* tun2socks patch: unlinked by hand below, bypassing TCP_RMV */
+      TCP_PCB_HASH_RMV(&tcp_active_pcbs, pcb);
       /* Remove PCB from tcp_active_pcbs list. */
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_active_pcbs", pcb != tcp_active_pcbs);
@@ -1454,6 +1537,8 @@ tcp_slowtmr_start:
     if (pcb_remove) {
       struct tcp_pcb *pcb2;
       tcp_pcb_purge(pcb);
+      /* tun2socks patch: unlinked by hand below, bypassing TCP_RMV */
+      TCP_PCB_HASH_RMV(&tcp_tw_pcbs, pcb);
       /* Remove PCB from tcp_tw_pcbs list. */
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_tw_pcbs", pcb != tcp_tw_pcbs);
@@ -1674,6 +1759,23 @@ tcp_seg_copy(struct tcp_seg *seg)
     return NULL;
   }
   SMEMCPY((u8_t *)cseg, (const u8_t *)seg, sizeof(struct tcp_seg));
+  if (PBUF_NEEDS_COPY(seg->p)) {
+    /* tun2socks patch: zero-copy input pbufs reference the caller's packet
+       buffer, which is only valid during ip_input(). Detach the segment into
+       heap memory, keeping the (already host-order) TCP header in front of
+       the payload so that cseg->tcphdr stays valid. */
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, (u16_t)(TCP_HLEN + seg->p->tot_len), PBUF_RAM);
+    if (q == NULL) {
+      memp_free(MEMP_TCP_SEG, cseg);
+      return NULL;
+    }
+    SMEMCPY(q->payload, seg->tcphdr, TCP_HLEN);
+    pbuf_copy_partial(seg->p, (u8_t *)q->payload + TCP_HLEN, seg->p->tot_len, 0);
+    cseg->tcphdr = (struct tcp_hdr *)q->payload;
+    pbuf_remove_header(q, TCP_HLEN);
+    cseg->p = q;
+    return cseg;
+  }
   pbuf_ref(cseg->p);
   return cseg;
 }
@@ -73,6 +73,9 @@
    function. */
 static struct tcp_seg inseg;
 static struct tcp_hdr *tcphdr;
+/* tun2socks patch: header (with options) of a zero-copy input segment,
+   converted here instead of in the caller's read-only packet buffer */
+static u32_t tcphdr_copy[60 / sizeof(u32_t)];
 static u16_t tcphdr_optlen;
 static u16_t tcphdr_opt1len;
 static u8_t *tcphdr_opt2;
@@ -86,6 +89,7 @@ static u8_t recv_flags;
 static struct pbuf *recv_data;
 
 struct tcp_pcb *tcp_input_pcb;
+u8_t tcp_input_defer_output;
 
 /* Forward declarations. */
 static err_t tcp_process(struct tcp_pcb *pcb);
@@ -119,6 +123,9 @@ tcp_input(struct pbuf *p, struct netif *inp)
 {
   struct tcp_pcb *pcb, *prev;
   struct tcp_pcb_listen *lpcb;
+#if LWIP_TCP_PCB_HASH
+  struct tcp_pcb *hash_pcb;
+#endif /* LWIP_TCP_PCB_HASH */
 #if SO_REUSE
   struct tcp_pcb *lpcb_prev = NULL;
   struct tcp_pcb_listen *lpcb_any = NULL;
@@ -179,6 +186,14 @@ tcp_input(struct pbuf *p, struct netif *inp)
     goto dropped;
   }
 
+  /* tun2socks patch: zero-copy input pbufs reference the caller's packet,
+     which must not be written to. Byte-swap (and later flag-trim) a copy of
+     the header instead; ooseq segments detach it in tcp_seg_copy(). */
+  if (PBUF_NEEDS_COPY(p) && p->len >= hdrlen_bytes) {
+    SMEMCPY(tcphdr_copy, p->payload, hdrlen_bytes);
+    tcphdr = (struct tcp_hdr *)tcphdr_copy;
+  }
+
   /* Move the payload pointer in the pbuf so that it points to the
      TCP data instead of the TCP header. */
   tcphdr_optlen = (u16_t)(hdrlen_bytes - TCP_HLEN);
@@ -247,6 +262,17 @@ tcp_input(struct pbuf *p, struct netif *inp)
      for an active connection. */
   prev = NULL;
 
+#if LWIP_TCP_PCB_HASH
+  /* tun2socks patch: one hash lookup covers both the active and the
+     TIME-WAIT list; the TIME-WAIT loop below then visits at most hash_pcb. */
+  hash_pcb = tcp_pcb_hash_lookup(ip_current_src_addr(), tcphdr->src,
+                                 ip_current_dest_addr(), tcphdr->dest);
+  if ((hash_pcb != NULL) && (hash_pcb->netif_idx != NETIF_NO_INDEX) &&
+      (hash_pcb->netif_idx != netif_get_index(ip_data.current_input_netif))) {
+    hash_pcb = NULL;
+  }
+  pcb = ((hash_pcb != NULL) && (hash_pcb->state != TIME_WAIT)) ? hash_pcb : NULL;
+#else /* LWIP_TCP_PCB_HASH */
   for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
     LWIP_ASSERT("tcp_input: active pcb->state != CLOSED", pcb->state != CLOSED);
     LWIP_ASSERT("tcp_input: active pcb->state != TIME-WAIT", pcb->state != TIME_WAIT);
@@ -279,11 +305,16 @@ tcp_input(struct pbuf *p, struct netif *inp)
     }
     prev = pcb;
   }
+#endif /* LWIP_TCP_PCB_HASH */
 
   if (pcb == NULL) {
     /* If it did not go to an active connection, we check the connections
        in the TIME-WAIT state. */
+#if LWIP_TCP_PCB_HASH
+    for (pcb = hash_pcb; pcb != NULL; pcb = NULL) {
+#else /* LWIP_TCP_PCB_HASH */
     for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+#endif /* LWIP_TCP_PCB_HASH */
       LWIP_ASSERT("tcp_input: TIME-WAIT pcb->state == TIME-WAIT", pcb->state == TIME_WAIT);
 
       /* check if PCB is bound to specific netif */
@@ -527,6 +558,17 @@ tcp_input(struct pbuf *p, struct netif *inp)
               pbuf_cat(recv_data, rest);
             }
 #endif /* TCP_QUEUE_OOSEQ && LWIP_WND_SCALE */
+            /* tun2socks patch: refused data outlives this input call, so it
+               must not keep referencing a zero-copy input buffer */
+            if (PBUF_NEEDS_COPY(recv_data)) {
+              struct pbuf *q = pbuf_clone(PBUF_RAW, PBUF_RAM, recv_data);
+              pbuf_free(recv_data);
+              if (q == NULL) {
+                tcp_abort(pcb);
+                goto aborted;
+              }
+              recv_data = q;
+            }
             pcb->refused_data = recv_data;
             LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: keep incoming packet, because pcb is \"full\"\n"));
 #if TCP_QUEUE_OOSEQ && LWIP_WND_SCALE
@@ -562,7 +604,13 @@ tcp_input(struct pbuf *p, struct netif *inp)
           goto aborted;
         }
         /* Try to send something out. */
-        tcp_output(pcb);
+        /* tun2socks patch: coalesce output when the caller feeds a batch of
+           segments; the caller flushes TF_OUTPUT_PEND PCBs afterwards. */
+        if (tcp_input_defer_output) {
+          tcp_set_flags(pcb, TF_OUTPUT_PEND);
+        } else {
+          tcp_output(pcb);
+        }
 #if TCP_INPUT_DEBUG
 #if TCP_DEBUG
         tcp_debug_print_state(pcb->state);
@@ -80,6 +80,89 @@ static u16_t udp_port = UDP_LOCAL_PORT_RANGE_START;
 /* exported in udp.h (was static) */
 struct udp_pcb *udp_pcbs;
 
+#if LWIP_UDP_PCB_HASH
+/* tun2socks patch: 4-tuple hash index over the connected PCBs on udp_pcbs.
+   A PCB is indexed while it is connected and on the list; every function that
+   changes its addresses, ports or connected state re-indexes it. */
+static struct udp_pcb *udp_pcb_hash_table[UDP_PCB_HASH_SIZE];
+
+static u32_t
+udp_pcb_hash(const ip_addr_t *local_ip, u16_t local_port,
+             const ip_addr_t *remote_ip, u16_t remote_port)
+{
+  u32_t h = ((u32_t)remote_port << 16) | local_port;
+#if LWIP_IPV6
+  if (IP_IS_V6(remote_ip)) {
+    const u32_t *r = ip_2_ip6(remote_ip)->addr;
+    const u32_t *l = ip_2_ip6(local_ip)->addr;
+    h ^= r[0] ^ r[1] ^ r[2] ^ r[3];
+    h = (h << 7) | (h >> 25);
+    h ^= l[0] ^ l[1] ^ l[2] ^ l[3];
+  }
+#endif /* LWIP_IPV6 */
+#if LWIP_IPV4
+  if (IP_IS_V4(remote_ip)) {
+    h ^= ip4_addr_get_u32(ip_2_ip4(remote_ip));
+    h = (h << 7) | (h >> 25);
+    h ^= ip4_addr_get_u32(ip_2_ip4(local_ip));
+  }
+#endif /* LWIP_IPV4 */
+  /* murmur3 finalizer */
+  h ^= h >> 16;
+  h *= 0x85ebca6bUL;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35UL;
+  h ^= h >> 16;
+  return h & (UDP_PCB_HASH_SIZE - 1);
+}
+
+static void
+udp_pcb_hash_remove(struct udp_pcb *pcb)
+{
+  u32_t idx = udp_pcb_hash(&pcb->local_ip, pcb->local_port, &pcb->remote_ip, pcb->remote_port);
+  struct udp_pcb **link;
+  for (link = &udp_pcb_hash_table[idx]; *link != NULL; link = &(*link)->hash_next) {
+    if (*link == pcb) {
+      *link = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+
+static void
+udp_pcb_hash_insert(struct udp_pcb *pcb)
+{
+  if (pcb->flags & UDP_FLAGS_CONNECTED) {
+    u32_t idx = udp_pcb_hash(&pcb->local_ip, pcb->local_port, &pcb->remote_ip, pcb->remote_port);
+    pcb->hash_next = udp_pcb_hash_table[idx];
+    udp_pcb_hash_table[idx] = pcb;
+  }
+}
+
+struct udp_pcb *
+udp_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                    const ip_addr_t *remote_ip, u16_t remote_port)
+{
+  struct udp_pcb *pcb = udp_pcb_hash_table[udp_pcb_hash(local_ip, local_port, remote_ip, remote_port)];
+  for (; pcb != NULL; pcb = pcb->hash_next) {
+    if (pcb->local_port == local_port &&
+        pcb->remote_port == remote_port &&
+        ip_addr_eq(&pcb->local_ip, local_ip) &&
+        ip_addr_eq(&pcb->remote_ip, remote_ip)) {
+      return pcb;
+    }
+  }
+  return NULL;
+}
+
+#define UDP_PCB_HASH_RMV(pcb) udp_pcb_hash_remove(pcb)
+#define UDP_PCB_HASH_REG(pcb) udp_pcb_hash_insert(pcb)
+#else /* LWIP_UDP_PCB_HASH */
+#define UDP_PCB_HASH_RMV(pcb)
+#define UDP_PCB_HASH_REG(pcb)
+#endif /* LWIP_UDP_PCB_HASH */
+
 /**
  * Initialize this module.
  */
@@ -89,6 +172,9 @@ udp_init(void)
 #ifdef LWIP_RAND
   udp_port = UDP_ENSURE_LOCAL_PORT_RANGE(LWIP_RAND());
 #endif /* LWIP_RAND */
+#if LWIP_UDP_PCB_HASH
+  memset(udp_pcb_hash_table, 0, sizeof(udp_pcb_hash_table));
+#endif /* LWIP_UDP_PCB_HASH */
 }
 
 /**
@@ -250,6 +336,12 @@ udp_input(struct pbuf *p, struct netif *inp)
    * 'Perfect match' pcbs (connected to the remote port & ip address) are
    * preferred. If no perfect match is found, the first unconnected pcb that
    * matches the local port and ip address gets the datagram. */
+#if LWIP_UDP_PCB_HASH
+  /* tun2socks patch: a connected PCB is found by hash; udp_pcbs is only
+     walked when there is none */
+  pcb = udp_pcb_hash_lookup(ip_current_dest_addr(), dest, ip_current_src_addr(), src);
+  if (pcb == NULL)
+#endif /* LWIP_UDP_PCB_HASH */
   for (pcb = udp_pcbs; pcb != NULL; pcb = pcb->next) {
     /* print the PCB local and remote address */
     LWIP_DEBUGF(UDP_DEBUG, ("pcb ("));
@@ -1024,6 +1116,7 @@ udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
     }
   }
 
+  UDP_PCB_HASH_RMV(pcb);
   ip_addr_set_ipaddr(&pcb->local_ip, ipaddr);
 
   pcb->local_port = port;
@@ -1034,6 +1127,7 @@ udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
     pcb->next = udp_pcbs;
     udp_pcbs = pcb;
   }
+  UDP_PCB_HASH_REG(pcb);
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("udp_bind: bound to "));
   ip_addr_debug_print_val(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, pcb->local_ip);
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, (", port %"U16_F")\n", pcb->local_port));
@@ -1098,6 +1192,7 @@ udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
     }
   }
 
+  UDP_PCB_HASH_RMV(pcb);
   ip_addr_set_ipaddr(&pcb->remote_ip, ipaddr);
 #if LWIP_IPV6 && LWIP_IPV6_SCOPES
   /* If the given IP address should have a zone but doesn't, assign one now,
@@ -1116,6 +1211,9 @@ udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
                           pcb->remote_ip);
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, (", port %"U16_F")\n", pcb->remote_port));
 
+  /* the PCB is on udp_pcbs once this function returns */
+  UDP_PCB_HASH_REG(pcb);
+
   /* Insert UDP PCB into the list of active UDP PCBs. */
   for (ipcb = udp_pcbs; ipcb != NULL; ipcb = ipcb->next) {
     if (pcb == ipcb) {
@@ -1143,6 +1241,7 @@ udp_disconnect(struct udp_pcb *pcb)
 
   LWIP_ERROR("udp_disconnect: invalid pcb", pcb != NULL, return);
 
+  UDP_PCB_HASH_RMV(pcb);
   /* reset remote address association */
 #if LWIP_IPV4 && LWIP_IPV6
   if (IP_IS_ANY_TYPE_VAL(pcb->local_ip)) {
@@ -1199,6 +1298,7 @@ udp_remove(struct udp_pcb *pcb)
   LWIP_ERROR("udp_remove: invalid pcb", pcb != NULL, return);
 
   mib2_udp_unbind(pcb);
+  UDP_PCB_HASH_RMV(pcb);
   /* pcb to be removed is first in list? */
   if (udp_pcbs == pcb) {
     /* make list start at 2nd pcb */
@@ -1302,7 +1402,9 @@ void udp_netif_ip_addr_changed(const ip_addr_t *old_addr, const ip_addr_t *new_a
       if (ip_addr_eq(&upcb->local_ip, old_addr)) {
         /* The PCB is bound to the old ipaddr and
          * is set to bound to the new one instead */
+        UDP_PCB_HASH_RMV(upcb);
         ip_addr_copy(upcb->local_ip, *new_addr);
+        UDP_PCB_HASH_REG(upcb);
       }
     }
   }
@@ -1236,6 +1236,21 @@
 #define UDP_TTL                         IP_DEFAULT_TTL
 #endif
 
+/**
+ * LWIP_UDP_PCB_HASH==1: udp_input() finds connected PCBs through a 4-tuple
+ * hash index before falling back to walking udp_pcbs (tun2socks patch).
+ */
+#if !defined LWIP_UDP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_UDP_PCB_HASH               0
+#endif
+
+/**
+ * UDP_PCB_HASH_SIZE: number of buckets in the UDP PCB hash index (power of two).
+ */
+#if !defined UDP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define UDP_PCB_HASH_SIZE               256
+#endif
+
 /**
  * LWIP_NETBUF_RECVINFO==1: append destination addr and port to every netbuf.
  */
@@ -1530,6 +1545,22 @@
 #define LWIP_TCP_PCB_NUM_EXT_ARGS       0
 #endif
 
+/**
+ * LWIP_TCP_PCB_HASH==1: tcp_input() finds the PCB for a segment through a
+ * 4-tuple hash index over tcp_active_pcbs and tcp_tw_pcbs instead of walking
+ * both lists (tun2socks patch).
+ */
+#if !defined LWIP_TCP_PCB_HASH || defined __DOXYGEN__
+#define LWIP_TCP_PCB_HASH               0
+#endif
+
+/**
+ * TCP_PCB_HASH_SIZE: number of buckets in the PCB hash index (power of two).
+ */
+#if !defined TCP_PCB_HASH_SIZE || defined __DOXYGEN__
+#define TCP_PCB_HASH_SIZE               256
+#endif
+
 /** LWIP_ALTCP==1: enable the altcp API.
  * altcp is an abstraction layer that prevents applications linking against the
  * tcp.h functions but provides the same functionality. It is used to e.g. add
@@ -323,6 +323,9 @@ struct tcp_seg {
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
 extern u8_t tcp_active_pcbs_changed;
+/* tun2socks patch: when set, tcp_input() marks PCBs with TF_OUTPUT_PEND
+   instead of calling tcp_output() per segment (see lwip_bridge_input_batch) */
+extern u8_t tcp_input_defer_output;
 
 /* The TCP PCB lists. */
 union tcp_listen_pcbs_t { /* List of all TCP PCBs in LISTEN state. */
@@ -336,6 +339,24 @@ extern struct tcp_pcb *tcp_active_pcbs;  /* List of all TCP PCBs that are in a
               data. */
 extern struct tcp_pcb *tcp_tw_pcbs;      /* List of all TCP PCBs in TIME-WAIT. */
 
+/* tun2socks patch: 4-tuple hash index over tcp_active_pcbs and tcp_tw_pcbs,
+   kept in sync by TCP_REG/TCP_RMV (see LWIP_TCP_PCB_HASH) */
+#if LWIP_TCP_PCB_HASH
+void tcp_pcb_hash_insert(struct tcp_pcb *pcb);
+void tcp_pcb_hash_remove(struct tcp_pcb *pcb);
+struct tcp_pcb *tcp_pcb_hash_lookup(const ip_addr_t *remote_ip, u16_t remote_port,
+                                    const ip_addr_t *local_ip, u16_t local_port);
+#define TCP_PCB_HASH_REG(pcbs, npcb) do { \
+    if ((pcbs) == &tcp_active_pcbs || (pcbs) == &tcp_tw_pcbs) tcp_pcb_hash_insert(npcb); \
+  } while (0)
+#define TCP_PCB_HASH_RMV(pcbs, npcb) do { \
+    if ((pcbs) == &tcp_active_pcbs || (pcbs) == &tcp_tw_pcbs) tcp_pcb_hash_remove(npcb); \
+  } while (0)
+#else /* LWIP_TCP_PCB_HASH */
+#define TCP_PCB_HASH_REG(pcbs, npcb)
+#define TCP_PCB_HASH_RMV(pcbs, npcb)
+#endif /* LWIP_TCP_PCB_HASH */
+
 #define NUM_TCP_PCB_LISTS_NO_TIME_WAIT  3
 #define NUM_TCP_PCB_LISTS               4
 extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
@@ -364,6 +385,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_PCB_HASH_REG(pcbs, npcb); \
                             LWIP_ASSERT("TCP_REG: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -380,6 +402,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_PCB_HASH_RMV(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (void *)(npcb), (void *)(*(pcbs)))); \
                             } while(0)
@@ -390,6 +413,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_PCB_HASH_REG(pcbs, npcb);                  \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -410,6 +434,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_PCB_HASH_RMV(pcbs, npcb);                  \
   } while(0)
 
 #endif /* LWIP_DEBUG */
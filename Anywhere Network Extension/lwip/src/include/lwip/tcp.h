@@ -248,6 +248,11 @@ struct tcp_pcb {
   /* ports are in host byte order */
   u16_t remote_port;
 
+#if LWIP_TCP_PCB_HASH
+  /* tun2socks patch: next PCB in the same hash index bucket */
+  struct tcp_pcb *hash_next;
+#endif /* LWIP_TCP_PCB_HASH */
+
   tcpflags_t flags;
 #define TF_ACK_DELAY   0x01U   /* Delayed ACK. */
 #define TF_ACK_NOW     0x02U   /* Immediate ACK. */
@@ -270,6 +275,7 @@ struct tcp_pcb {
 #if LWIP_TCP_SACK_OUT
 #define TF_SACK        0x1000U /* Selective ACKs enabled */
 #endif
+#define TF_OUTPUT_PEND 0x2000U /* tun2socks patch: tcp_output deferred until the end of an input batch */
 
   /* the rest of the fields are in host byte order
      as we have to do some math with them */
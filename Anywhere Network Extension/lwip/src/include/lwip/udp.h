@@ -85,6 +85,10 @@ struct udp_pcb {
 /* Protocol specific PCB members */
 
   struct udp_pcb *next;
+#if LWIP_UDP_PCB_HASH
+  /* tun2socks patch: next PCB in the same hash index bucket */
+  struct udp_pcb *hash_next;
+#endif /* LWIP_UDP_PCB_HASH */
 
   u8_t flags;
   /** ports are in host byte order */
@@ -114,6 +118,12 @@ struct udp_pcb {
 /* udp_pcbs export for external reference (e.g. SNMP agent) */
 extern struct udp_pcb *udp_pcbs;
 
+#if LWIP_UDP_PCB_HASH
+/* tun2socks patch: find the connected PCB for a 4-tuple (see LWIP_UDP_PCB_HASH) */
+struct udp_pcb *udp_pcb_hash_lookup(const ip_addr_t *local_ip, u16_t local_port,
+                                    const ip_addr_t *remote_ip, u16_t remote_port);
+#endif /* LWIP_UDP_PCB_HASH */
+
 /* The following functions is the application layer interface to the
    UDP code. */
 struct udp_pcb * udp_new        (void);
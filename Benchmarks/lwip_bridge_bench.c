@@ -0,0 +1,807 @@
+//
+//  lwip_bridge_bench.c
+//  Benchmarks
+//
+//  Packet-replay benchmark for the lwIP bridge. Drives lwip_bridge_input_batch()
+//  with synthetic TCP/UDP flows (or a pcap capture) against stub callbacks and
+//  reports packets/s, bytes/s, ns per packet and allocations per packet.
+//
+//  Usage: lwip_bridge_bench [-f tcp_flows] [-n segments] [-u udp_flows]
+//                           [-d datagrams] [-b batch] [-z] [-r file.pcap]
+//
+
+#include "lwip_bridge.h"
+#include "lwip/opt.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ========================================================================
+ *  Allocation counters
+ *
+ *  With BENCH_COUNT_ALLOCS the binary is linked with --wrap for the libc
+ *  allocator and lwIP's heap/pool allocators (see CMakeLists.txt).
+ * ======================================================================== */
+
+static uint64_t s_libc_allocs = 0;
+static uint64_t s_heap_allocs = 0;
+static uint64_t s_memp_allocs = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_mem_malloc(mem_size_t size);
+void *__real_memp_malloc(memp_t type);
+
+void *__wrap_malloc(size_t size)                { s_libc_allocs++; return __real_malloc(size); }
+void *__wrap_calloc(size_t n, size_t size)      { s_libc_allocs++; return __real_calloc(n, size); }
+void *__wrap_realloc(void *ptr, size_t size)    { s_libc_allocs++; return __real_realloc(ptr, size); }
+void *__wrap_mem_malloc(mem_size_t size)        { s_heap_allocs++; return __real_mem_malloc(size); }
+void *__wrap_memp_malloc(memp_t type)           { s_memp_allocs++; return __real_memp_malloc(type); }
+#endif
+
+/* ========================================================================
+ *  Flow table
+ * ======================================================================== */
+
+#define FLOW_TABLE_SIZE 65536   /* power of two */
+
+struct flow_key {
+    uint8_t  cli_ip[16];
+    uint8_t  srv_ip[16];
+    uint16_t cli_port;
+    uint16_t srv_port;
+    uint8_t  is_ipv6;
+};
+
+struct flow {
+    struct flow_key key;
+    int      used;
+    void    *pcb;
+    int      closed;
+    uint32_t cli_next;          /* next client sequence number */
+    uint32_t srv_isn;           /* stack ISN from its SYN-ACK */
+    uint32_t srv_next;          /* highest stack sequence seen + 1 */
+    int      srv_isn_known;
+    uint32_t cap_srv_isn;       /* pcap: server ISN in the capture */
+    int      cap_srv_isn_known;
+};
+
+static struct flow *s_flows = NULL;
+static size_t s_flow_count = 0;
+
+static uint32_t flow_hash(const struct flow_key *k) {
+    /* FNV-1a */
+    const uint8_t *b = (const uint8_t *)k;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(*k); i++) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct flow *flow_lookup(const struct flow_key *k, int create) {
+    uint32_t i = flow_hash(k) & (FLOW_TABLE_SIZE - 1);
+    for (uint32_t probe = 0; probe < FLOW_TABLE_SIZE; probe++) {
+        struct flow *f = &s_flows[(i + probe) & (FLOW_TABLE_SIZE - 1)];
+        if (!f->used) {
+            if (!create) return NULL;
+            memset(f, 0, sizeof(*f));
+            f->key = *k;
+            f->used = 1;
+            s_flow_count++;
+            return f;
+        }
+        if (memcmp(&f->key, k, sizeof(*k)) == 0) return f;
+    }
+    return NULL;
+}
+
+static void make_key(struct flow_key *k, const uint8_t *cli_ip, uint16_t cli_port,
+                     const uint8_t *srv_ip, uint16_t srv_port, int is_ipv6) {
+    memset(k, 0, sizeof(*k));
+    memcpy(k->cli_ip, cli_ip, is_ipv6 ? 16 : 4);
+    memcpy(k->srv_ip, srv_ip, is_ipv6 ? 16 : 4);
+    k->cli_port = cli_port;
+    k->srv_port = srv_port;
+    k->is_ipv6 = (uint8_t)is_ipv6;
+}
+
+/* ========================================================================
+ *  Packet parsing
+ * ======================================================================== */
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+struct pkt_info {
+    int      is_ipv6;
+    uint8_t  proto;
+    const uint8_t *src_ip;
+    const uint8_t *dst_ip;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint32_t seq;
+    uint32_t ack;
+    uint8_t  flags;
+    size_t   l4_offset;
+    size_t   payload_len;
+};
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static uint32_t rd32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+static void wr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void wr32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+/* Parses an IPv4/IPv6 TCP or UDP packet. Returns 0 for anything else. */
+static int parse_packet(const uint8_t *pkt, size_t len, struct pkt_info *info) {
+    if (len < 1) return 0;
+    size_t ip_total;
+    memset(info, 0, sizeof(*info));
+    if ((pkt[0] >> 4) == 4) {
+        if (len < 20) return 0;
+        size_t ihl = (size_t)(pkt[0] & 0x0f) * 4;
+        ip_total = rd16(pkt + 2);
+        if (ihl < 20 || ip_total > len || ip_total < ihl) return 0;
+        info->proto = pkt[9];
+        info->src_ip = pkt + 12;
+        info->dst_ip = pkt + 16;
+        info->l4_offset = ihl;
+    } else if ((pkt[0] >> 4) == 6) {
+        if (len < 40) return 0;
+        ip_total = 40 + (size_t)rd16(pkt + 4);
+        if (ip_total > len) return 0;
+        info->is_ipv6 = 1;
+        info->proto = pkt[6];     /* extension headers are not followed */
+        info->src_ip = pkt + 8;
+        info->dst_ip = pkt + 24;
+        info->l4_offset = 40;
+    } else {
+        return 0;
+    }
+
+    const uint8_t *l4 = pkt + info->l4_offset;
+    size_t l4_len = ip_total - info->l4_offset;
+    if (info->proto == 6) {
+        if (l4_len < 20) return 0;
+        size_t doff = (size_t)(l4[12] >> 4) * 4;
+        if (doff < 20 || doff > l4_len) return 0;
+        info->src_port = rd16(l4);
+        info->dst_port = rd16(l4 + 2);
+        info->seq = rd32(l4 + 4);
+        info->ack = rd32(l4 + 8);
+        info->flags = l4[13];
+        info->payload_len = l4_len - doff;
+        return 1;
+    }
+    if (info->proto == 17) {
+        if (l4_len < 8) return 0;
+        info->src_port = rd16(l4);
+        info->dst_port = rd16(l4 + 2);
+        info->payload_len = l4_len - 8;
+        return 1;
+    }
+    return 0;
+}
+
+/* ========================================================================
+ *  Packet construction (IPv4; checksums are not verified by the stack)
+ * ======================================================================== */
+
+#define BENCH_MSS       1360
+#define BENCH_PKT_MAX   2048
+
+static size_t build_tcp4(uint8_t *buf, const struct flow *f, uint32_t seq, uint32_t ack,
+                         uint8_t flags, size_t payload_len) {
+    size_t total = 20 + 20 + payload_len;
+    memset(buf, 0, 40);
+    buf[0] = 0x45;
+    wr16(buf + 2, (uint16_t)total);
+    buf[8] = 64;
+    buf[9] = 6;
+    memcpy(buf + 12, f->key.cli_ip, 4);
+    memcpy(buf + 16, f->key.srv_ip, 4);
+
+    uint8_t *tcp = buf + 20;
+    wr16(tcp, f->key.cli_port);
+    wr16(tcp + 2, f->key.srv_port);
+    wr32(tcp + 4, seq);
+    wr32(tcp + 8, ack);
+    tcp[12] = 5 << 4;
+    tcp[13] = flags;
+    wr16(tcp + 14, 65535);
+    if (payload_len) memset(tcp + 20, 0xa5, payload_len);
+    return total;
+}
+
+/* SYN carrying an MSS option, so the stack does not fall back to 536 bytes */
+static size_t build_syn4(uint8_t *buf, const struct flow *f, uint32_t seq) {
+    size_t total = build_tcp4(buf, f, seq, 0, TCP_SYN, 4);
+    uint8_t *tcp = buf + 20;
+    tcp[12] = 6 << 4;
+    tcp[20] = 2;
+    tcp[21] = 4;
+    wr16(tcp + 22, BENCH_MSS + 40);
+    return total;
+}
+
+static size_t build_udp4(uint8_t *buf, const uint8_t *src, uint16_t sport,
+                         const uint8_t *dst, uint16_t dport, size_t payload_len) {
+    size_t total = 20 + 8 + payload_len;
+    memset(buf, 0, 28);
+    buf[0] = 0x45;
+    wr16(buf + 2, (uint16_t)total);
+    buf[8] = 64;
+    buf[9] = 17;
+    memcpy(buf + 12, src, 4);
+    memcpy(buf + 16, dst, 4);
+    wr16(buf + 20, sport);
+    wr16(buf + 22, dport);
+    wr16(buf + 24, (uint16_t)(8 + payload_len));
+    if (payload_len) memset(buf + 28, 0x5a, payload_len);
+    return total;
+}
+
+/* ========================================================================
+ *  Stub callbacks
+ * ======================================================================== */
+
+static uint64_t s_out_pkts = 0;
+static uint64_t s_out_bytes = 0;
+static uint64_t s_recv_bytes = 0;
+static uint64_t s_udp_recv_pkts = 0;
+
+/* Tracks the stack's sequence space from packets it emits towards clients */
+static void observe_output(const uint8_t *pkt, size_t len) {
+    struct pkt_info info;
+    if (!parse_packet(pkt, len, &info) || info.proto != 6) return;
+
+    struct flow_key k;
+    make_key(&k, info.dst_ip, info.dst_port, info.src_ip, info.src_port, info.is_ipv6);
+    struct flow *f = flow_lookup(&k, 0);
+    if (!f) return;
+
+    uint32_t end = info.seq + (uint32_t)info.payload_len;
+    if (info.flags & (TCP_SYN | TCP_FIN)) end++;
+    if (info.flags & TCP_SYN) {
+        f->srv_isn = info.seq;
+        f->srv_isn_known = 1;
+        f->srv_next = end;
+    } else if ((int32_t)(end - f->srv_next) > 0) {
+        f->srv_next = end;
+    }
+    if (info.flags & TCP_RST) f->closed = 1;
+}
+
+/* Gathers the batch into one buffer, as LWIPStack does before writePackets */
+static void bench_output_batch(const struct iovec *iov, const int *iovcnt,
+                               const int *is_ipv6, int count) {
+    (void)is_ipv6;
+    size_t total = 0;
+    int nsegs = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < iovcnt[i]; j++) total += iov[nsegs++].iov_len;
+    }
+    uint8_t *buf = malloc(total);
+    if (!buf) return;
+
+    size_t off = 0;
+    const struct iovec *seg = iov;
+    for (int i = 0; i < count; i++) {
+        size_t start = off;
+        for (int j = 0; j < iovcnt[i]; j++, seg++) {
+            memcpy(buf + off, seg->iov_base, seg->iov_len);
+            off += seg->iov_len;
+        }
+        observe_output(buf + start, off - start);
+        s_out_pkts++;
+        s_out_bytes += (uint64_t)(off - start);
+    }
+    free(buf);
+}
+
+static void *bench_tcp_accept(const void *src_ip, uint16_t src_port,
+                              const void *dst_ip, uint16_t dst_port,
+                              int is_ipv6, void *pcb) {
+    struct flow_key k;
+    make_key(&k, src_ip, src_port, dst_ip, dst_port, is_ipv6);
+    struct flow *f = flow_lookup(&k, 1);
+    if (!f) return NULL;
+    f->pcb = pcb;
+    return f;
+}
+
+static void bench_tcp_recv(void *conn, const void *data, int len) {
+    struct flow *f = (struct flow *)conn;
+    if (!data || len <= 0) return;
+    s_recv_bytes += (uint64_t)len;
+    /* Consume immediately, like a proxy with an idle uplink */
+    lwip_bridge_tcp_recved(f->pcb, (uint16_t)len);
+}
+
+static void bench_tcp_sent(void *conn, uint16_t len) {
+    (void)conn; (void)len;
+}
+
+static void bench_tcp_err(void *conn, int err) {
+    (void)err;
+    struct flow *f = (struct flow *)conn;
+    f->pcb = NULL;
+    f->closed = 1;
+}
+
+static void bench_udp_recv(const void *src_ip, uint16_t src_port,
+                           const void *dst_ip, uint16_t dst_port,
+                           int is_ipv6, const void *data, int len) {
+    (void)src_ip; (void)src_port; (void)dst_ip; (void)dst_port; (void)is_ipv6; (void)data;
+    s_udp_recv_pkts++;
+    s_recv_bytes += (uint64_t)len;
+}
+
+static void bench_log(int level, const char *message) {
+    if (level == LWIP_LOG_ERROR) fprintf(stderr, "%s\n", message);
+}
+
+/* ========================================================================
+ *  Measurement
+ * ======================================================================== */
+
+struct phase_stats {
+    const char *name;
+    uint64_t pkts;
+    uint64_t bytes;             /* payload bytes injected */
+    uint64_t ns;
+    uint64_t libc_allocs, heap_allocs, memp_allocs;
+    uint64_t out_pkts;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int s_batch_size = 64;
+static uint8_t (*s_batch_buf)[BENCH_PKT_MAX];
+static size_t s_batch_buf_size;
+static int s_batch_read_only = 0;
+static const void **s_batch_ptrs;
+static int *s_batch_lens;
+static int s_batch_count = 0;
+static uint64_t s_batch_payload = 0;
+
+static void phase_begin(struct phase_stats *st, const char *name) {
+    memset(st, 0, sizeof(*st));
+    st->name = name;
+}
+
+/* Injects the pending batch; only the bridge call itself is timed */
+static void batch_flush(struct phase_stats *st) {
+    if (s_batch_count == 0) return;
+    uint64_t libc0 = s_libc_allocs, heap0 = s_heap_allocs, memp0 = s_memp_allocs;
+    uint64_t out0 = s_out_pkts;
+    /* Zero-copy input must leave the caller's packets untouched: any write
+     * by lwIP faults while the batch is mapped read-only */
+    if (s_batch_read_only) mprotect(s_batch_buf, s_batch_buf_size, PROT_READ);
+    uint64_t t0 = now_ns();
+    lwip_bridge_input_batch(s_batch_ptrs, s_batch_lens, s_batch_count);
+    lwip_bridge_check_timeouts();
+    st->ns += now_ns() - t0;
+    if (s_batch_read_only) mprotect(s_batch_buf, s_batch_buf_size, PROT_READ | PROT_WRITE);
+    st->libc_allocs += s_libc_allocs - libc0;
+    st->heap_allocs += s_heap_allocs - heap0;
+    st->memp_allocs += s_memp_allocs - memp0;
+    st->out_pkts += s_out_pkts - out0;
+    st->pkts += (uint64_t)s_batch_count;
+    st->bytes += s_batch_payload;
+    s_batch_count = 0;
+    s_batch_payload = 0;
+}
+
+static uint8_t *batch_slot(struct phase_stats *st) {
+    if (s_batch_count == s_batch_size) batch_flush(st);
+    return s_batch_buf[s_batch_count];
+}
+
+static void batch_commit(size_t len, size_t payload_len) {
+    s_batch_ptrs[s_batch_count] = s_batch_buf[s_batch_count];
+    s_batch_lens[s_batch_count] = (int)len;
+    s_batch_payload += payload_len;
+    s_batch_count++;
+}
+
+static void phase_report(const struct phase_stats *st) {
+    if (st->pkts == 0) {
+        printf("%-12s  no packets\n", st->name);
+        return;
+    }
+    double secs = (double)st->ns / 1e9;
+    double pkts = (double)st->pkts;
+    printf("%-12s %10llu pkts %12.0f pkts/s %10.2f MB/s %8.1f ns/pkt"
+           "  allocs/pkt libc %.2f heap %.2f memp %.2f  out %llu\n",
+           st->name, (unsigned long long)st->pkts,
+           secs > 0 ? pkts / secs : 0.0,
+           secs > 0 ? (double)st->bytes / secs / 1e6 : 0.0,
+           (double)st->ns / pkts,
+           (double)st->libc_allocs / pkts,
+           (double)st->heap_allocs / pkts,
+           (double)st->memp_allocs / pkts,
+           (unsigned long long)st->out_pkts);
+}
+
+/* ========================================================================
+ *  Synthetic workload
+ * ======================================================================== */
+
+static struct flow **s_tcp_flows;
+
+static void run_synthetic(int tcp_flows, int segments, int udp_flows, int datagrams) {
+    struct phase_stats st;
+    uint8_t cli_ip[4] = { 10, 0, 0, 2 };
+    uint8_t srv_ip[4] = { 93, 184, 216, 34 };
+
+    s_tcp_flows = calloc((size_t)tcp_flows, sizeof(*s_tcp_flows));
+    if (!s_tcp_flows) return;
+    for (int i = 0; i < tcp_flows; i++) {
+        struct flow_key k;
+        make_key(&k, cli_ip, (uint16_t)(10000 + i), srv_ip, 443, 0);
+        s_tcp_flows[i] = flow_lookup(&k, 1);
+        s_tcp_flows[i]->cli_next = 1000000u * (uint32_t)(i + 1);
+    }
+
+    /* --- Handshakes: SYN, then ACK of the SYN-ACK --- */
+    phase_begin(&st, "handshake");
+    for (int i = 0; i < tcp_flows; i++) {
+        struct flow *f = s_tcp_flows[i];
+        uint8_t *buf = batch_slot(&st);
+        batch_commit(build_syn4(buf, f, f->cli_next), 0);
+        f->cli_next++;
+    }
+    batch_flush(&st);
+    for (int i = 0; i < tcp_flows; i++) {
+        struct flow *f = s_tcp_flows[i];
+        if (!f->srv_isn_known) continue;
+        uint8_t *buf = batch_slot(&st);
+        batch_commit(build_tcp4(buf, f, f->cli_next, f->srv_next, TCP_ACK, 0), 0);
+    }
+    batch_flush(&st);
+    phase_report(&st);
+
+    /* --- Uplink bulk data: MSS-sized segments, interleaved across flows --- */
+    phase_begin(&st, "bulk-up");
+    for (int s = 0; s < segments; s++) {
+        for (int i = 0; i < tcp_flows; i++) {
+            struct flow *f = s_tcp_flows[i];
+            if (!f->pcb || f->closed) continue;
+            uint8_t *buf = batch_slot(&st);
+            batch_commit(build_tcp4(buf, f, f->cli_next, f->srv_next, TCP_ACK | TCP_PSH, BENCH_MSS),
+                         BENCH_MSS);
+            f->cli_next += BENCH_MSS;
+        }
+    }
+    batch_flush(&st);
+    phase_report(&st);
+
+    /* --- Downlink ACK stream: the stack sends, the client ACKs every 2 MSS.
+     * A flow is refilled only once its unsent data has gone out, and refills
+     * are sized so that all flows together stay within half of MEM_SIZE. --- */
+    static uint8_t payload[4 * BENCH_MSS];
+    memset(payload, 0xc3, sizeof(payload));
+    phase_begin(&st, "ack-stream");
+    uint64_t target = (uint64_t)segments * BENCH_MSS;
+    int refill = tcp_flows > 0 ? (int)(MEM_SIZE / 2 / tcp_flows) / (BENCH_MSS + 64) * BENCH_MSS : 0;
+    if (refill > (int)sizeof(payload)) refill = (int)sizeof(payload);
+    if (refill < BENCH_MSS) refill = BENCH_MSS;
+    uint64_t *written = calloc((size_t)tcp_flows, sizeof(uint64_t));
+    uint32_t *acked = calloc((size_t)tcp_flows, sizeof(uint32_t));
+    uint32_t *base = calloc((size_t)tcp_flows, sizeof(uint32_t));
+    if (!written || !acked || !base) {
+        free(written);
+        free(acked);
+        free(base);
+        return;
+    }
+    for (int i = 0; i < tcp_flows; i++) acked[i] = base[i] = s_tcp_flows[i]->srv_next;
+    int progress = 1;
+    while (progress) {
+        progress = 0;
+        for (int i = 0; i < tcp_flows; i++) {
+            struct flow *f = s_tcp_flows[i];
+            if (!f->pcb || f->closed || written[i] >= target) continue;
+            if (written[i] > (uint64_t)(f->srv_next - base[i])) continue;
+            int sndbuf = lwip_bridge_tcp_sndbuf(f->pcb);
+            uint64_t remaining = target - written[i];
+            int chunk = (int)(remaining < (uint64_t)sndbuf ? remaining : (uint64_t)sndbuf);
+            if (chunk > refill) chunk = refill;
+            if (chunk > 0 && lwip_bridge_tcp_write(f->pcb, payload, (uint16_t)chunk) == 0) {
+                written[i] += (uint64_t)chunk;
+            }
+            lwip_bridge_tcp_output(f->pcb);
+        }
+        for (int i = 0; i < tcp_flows; i++) {
+            struct flow *f = s_tcp_flows[i];
+            if (!f->pcb || f->closed) continue;
+            while ((int32_t)(f->srv_next - acked[i]) > 0) {
+                uint32_t step = f->srv_next - acked[i];
+                if (step > 2 * BENCH_MSS) step = 2 * BENCH_MSS;
+                acked[i] += step;
+                uint8_t *buf = batch_slot(&st);
+                batch_commit(build_tcp4(buf, f, f->cli_next, acked[i], TCP_ACK, 0), 0);
+                progress = 1;
+            }
+        }
+        batch_flush(&st);
+    }
+    free(written);
+    free(acked);
+    free(base);
+    phase_report(&st);
+
+    /* --- UDP datagrams --- */
+    phase_begin(&st, "udp");
+    uint8_t dns_ip[4] = { 8, 8, 8, 8 };
+    for (int d = 0; d < datagrams; d++) {
+        for (int i = 0; i < udp_flows; i++) {
+            uint8_t *buf = batch_slot(&st);
+            batch_commit(build_udp4(buf, cli_ip, (uint16_t)(30000 + i), dns_ip, 53, 512), 512);
+        }
+    }
+    batch_flush(&st);
+    phase_report(&st);
+
+    /* --- UDP replies (downlink, lwip_bridge_udp_sendto) --- */
+    phase_begin(&st, "udp-reply");
+    uint8_t reply[512];
+    memset(reply, 0xA5, sizeof(reply));
+    for (int d = 0; d < datagrams; d++) {
+        for (int i = 0; i < udp_flows; i++) {
+            uint64_t libc0 = s_libc_allocs, heap0 = s_heap_allocs, memp0 = s_memp_allocs;
+            uint64_t out0 = s_out_pkts;
+            uint64_t t0 = now_ns();
+            lwip_bridge_udp_sendto(dns_ip, 53, cli_ip, (uint16_t)(30000 + i), 0,
+                                   reply, (int)sizeof(reply));
+            st.ns += now_ns() - t0;
+            st.libc_allocs += s_libc_allocs - libc0;
+            st.heap_allocs += s_heap_allocs - heap0;
+            st.memp_allocs += s_memp_allocs - memp0;
+            st.out_pkts += s_out_pkts - out0;
+            st.pkts++;
+            st.bytes += sizeof(reply);
+        }
+    }
+    for (int i = 0; i < udp_flows; i++) {
+        lwip_bridge_udp_release(dns_ip, 53, cli_ip, (uint16_t)(30000 + i), 0);
+    }
+    phase_report(&st);
+}
+
+/* ========================================================================
+ *  pcap replay
+ *
+ *  Replays the client side of each captured flow as fast as possible:
+ *  TCP packets are injected from the first SYN onward with their ACK
+ *  numbers rebased onto the stack's ISN; server-side packets only supply
+ *  the captured server ISN. UDP packets are injected as-is.
+ * ======================================================================== */
+
+static uint32_t pcap_u32(const uint8_t *p, int swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+/* Returns the link-layer header length for a linktype, or -1 if unsupported */
+static int link_header_len(uint32_t linktype, const uint8_t *frame, size_t caplen) {
+    switch (linktype) {
+    case 0:   /* NULL */
+    case 108: /* LOOP */
+        return 4;
+    case 1:   /* Ethernet */
+        if (caplen >= 18 && rd16(frame + 12) == 0x8100) return 18;
+        return 14;
+    case 12:  /* DLT_RAW (OpenBSD) */
+    case 101: /* RAW */
+    case 228: /* IPV4 */
+    case 229: /* IPV6 */
+        return 0;
+    case 113: /* LINUX_SLL */
+        return 16;
+    case 276: /* LINUX_SLL2 */
+        return 20;
+    default:
+        return -1;
+    }
+}
+
+static int run_pcap(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return 1;
+    }
+    uint8_t gh[24];
+    if (fread(gh, 1, sizeof(gh), fp) != sizeof(gh)) {
+        fprintf(stderr, "%s: short pcap header\n", path);
+        fclose(fp);
+        return 1;
+    }
+    uint32_t magic;
+    memcpy(&magic, gh, 4);
+    int swap;
+    if (magic == 0xa1b2c3d4u || magic == 0xa1b23c4du) {
+        swap = 0;
+    } else if (magic == 0xd4c3b2a1u || magic == 0x4d3cb2a1u) {
+        swap = 1;
+    } else {
+        fprintf(stderr, "%s: not a classic pcap file (pcapng is not supported)\n", path);
+        fclose(fp);
+        return 1;
+    }
+    uint32_t linktype = pcap_u32(gh + 20, swap) & 0x0fffffff;
+
+    struct phase_stats st;
+    phase_begin(&st, "pcap");
+    uint64_t skipped = 0;
+    static uint8_t frame[65536];
+    uint8_t rh[16];
+    while (fread(rh, 1, sizeof(rh), fp) == sizeof(rh)) {
+        uint32_t caplen = pcap_u32(rh + 8, swap);
+        if (caplen > sizeof(frame) || fread(frame, 1, caplen, fp) != caplen) break;
+
+        int hl = link_header_len(linktype, frame, caplen);
+        if (hl < 0) {
+            fprintf(stderr, "%s: unsupported linktype %u\n", path, linktype);
+            fclose(fp);
+            return 1;
+        }
+        if ((size_t)hl >= caplen || caplen - (size_t)hl > BENCH_PKT_MAX) { skipped++; continue; }
+        uint8_t *pkt = frame + hl;
+        size_t len = caplen - (size_t)hl;
+
+        struct pkt_info info;
+        if (!parse_packet(pkt, len, &info)) { skipped++; continue; }
+
+        if (info.proto == 6) {
+            struct flow_key k;
+            make_key(&k, info.src_ip, info.src_port, info.dst_ip, info.dst_port, info.is_ipv6);
+            struct flow *f = flow_lookup(&k, 0);
+            if (!f) {
+                /* Server-side packet: record the captured ISN from the SYN-ACK */
+                struct flow_key rk;
+                make_key(&rk, info.dst_ip, info.dst_port, info.src_ip, info.src_port, info.is_ipv6);
+                struct flow *rf = flow_lookup(&rk, 0);
+                if (rf && (info.flags & TCP_SYN) && (info.flags & TCP_ACK)) {
+                    rf->cap_srv_isn = info.seq;
+                    rf->cap_srv_isn_known = 1;
+                    skipped++;
+                    continue;
+                }
+                if (rf || !(info.flags & TCP_SYN) || (info.flags & TCP_ACK)) { skipped++; continue; }
+                f = flow_lookup(&k, 1);
+                if (!f) { skipped++; continue; }
+            }
+            if ((info.flags & TCP_ACK) && f->cap_srv_isn_known) {
+                /* The stack's ISN is only known once the queued SYN is processed */
+                if (!f->srv_isn_known) batch_flush(&st);
+                if (f->srv_isn_known) {
+                    wr32(pkt + info.l4_offset + 8, info.ack - f->cap_srv_isn + f->srv_isn);
+                }
+            }
+        }
+
+        uint8_t *buf = batch_slot(&st);
+        memcpy(buf, pkt, len);
+        batch_commit(len, info.payload_len);
+    }
+    batch_flush(&st);
+    fclose(fp);
+
+    phase_report(&st);
+    printf("pcap: %llu packets skipped, %zu TCP flows, %llu bytes delivered\n",
+           (unsigned long long)skipped, s_flow_count, (unsigned long long)s_recv_bytes);
+    return 0;
+}
+
+/* ========================================================================
+ *  Main
+ * ======================================================================== */
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-f tcp_flows] [-n segments] [-u udp_flows] [-d datagrams]\n"
+            "          [-b batch] [-z] [-r file.pcap]\n"
+            "  -f  concurrent TCP flows (default 64, max %d)\n"
+            "  -n  MSS segments per flow, each direction (default 256)\n"
+            "  -u  UDP flows (default 64)\n"
+            "  -d  datagrams per UDP flow (default 256)\n"
+            "  -b  packets per lwip_bridge_input_batch call (default 64)\n"
+            "  -z  zero-copy (PBUF_REF) packet input, from read-only memory\n"
+            "  -r  replay a classic pcap file instead of the synthetic workload\n",
+            argv0, MEMP_NUM_TCP_PCB);
+}
+
+int main(int argc, char **argv) {
+    int tcp_flows = 64, segments = 256, udp_flows = 64, datagrams = 256;
+    int zero_copy = 0;
+    const char *pcap_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:u:d:b:zr:h")) != -1) {
+        switch (opt) {
+        case 'f': tcp_flows = atoi(optarg); break;
+        case 'n': segments = atoi(optarg); break;
+        case 'u': udp_flows = atoi(optarg); break;
+        case 'd': datagrams = atoi(optarg); break;
+        case 'b': s_batch_size = atoi(optarg); break;
+        case 'z': zero_copy = 1; break;
+        case 'r': pcap_path = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (tcp_flows < 0 || tcp_flows > MEMP_NUM_TCP_PCB || segments < 0 ||
+        udp_flows < 0 || datagrams < 0 || s_batch_size < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    s_flows = calloc(FLOW_TABLE_SIZE, sizeof(*s_flows));
+    s_batch_buf_size = (size_t)s_batch_size * sizeof(*s_batch_buf);
+    s_batch_buf = mmap(NULL, s_batch_buf_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (s_batch_buf == MAP_FAILED) s_batch_buf = NULL;
+    s_batch_read_only = zero_copy;
+    s_batch_ptrs = malloc((size_t)s_batch_size * sizeof(*s_batch_ptrs));
+    s_batch_lens = malloc((size_t)s_batch_size * sizeof(*s_batch_lens));
+    if (!s_flows || !s_batch_buf || !s_batch_ptrs || !s_batch_lens) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    lwip_bridge_set_log_fn(bench_log);
+    lwip_bridge_set_output_batch_fn(bench_output_batch);
+    lwip_bridge_set_tcp_accept_fn(bench_tcp_accept);
+    lwip_bridge_set_tcp_recv_fn(bench_tcp_recv);
+    lwip_bridge_set_tcp_sent_fn(bench_tcp_sent);
+    lwip_bridge_set_tcp_err_fn(bench_tcp_err);
+    lwip_bridge_set_udp_recv_fn(bench_udp_recv);
+    lwip_bridge_init();
+    lwip_bridge_set_zero_copy_input(zero_copy);
+
+    printf("config: TCP_WND=%d TCP_SND_BUF=%d MEM_SIZE=%d PBUF_POOL_SIZE=%d batch=%d zero-copy=%d%s\n",
+           (int)TCP_WND, (int)TCP_SND_BUF, (int)MEM_SIZE, (int)PBUF_POOL_SIZE,
+           s_batch_size, zero_copy,
+#ifdef BENCH_COUNT_ALLOCS
+           ""
+#else
+           " (allocation counting unavailable)"
+#endif
+           );
+
+    int rc = 0;
+    if (pcap_path) {
+        rc = run_pcap(pcap_path);
+    } else {
+        run_synthetic(tcp_flows, segments, udp_flows, datagrams);
+        printf("delivered: %llu bytes to TCP/UDP callbacks, %llu UDP datagrams; output: %llu pkts %llu bytes\n",
+               (unsigned long long)s_recv_bytes, (unsigned long long)s_udp_recv_pkts,
+               (unsigned long long)s_out_pkts, (unsigned long long)s_out_bytes);
+    }
+
+    lwip_bridge_shutdown();
+    return rc;
+}
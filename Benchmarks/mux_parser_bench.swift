@@ -0,0 +1,148 @@
+//
+//  mux_parser_bench.swift
+//  Benchmarks
+//
+//  Microbenchmark for MuxFrameParser. Encodes a stream of small Keep frames
+//  carrying data (the shape of XUDP traffic), cuts it into network-sized
+//  reads and feeds them through the parser, reporting frames/s and MB/s. The
+//  previous parser, which removed each frame from the front of its buffer, is
+//  kept here as a baseline.
+//
+//  Foundation only, so it runs outside the CMake build:
+//    swiftc -O Protocols/Mux/MuxFrame.swift Benchmarks/mux_parser_bench.swift -o mux_parser_bench
+//
+//  Usage: mux_parser_bench [-f frames] [-s payload] [-r read] [-n iterations]
+//
+
+import Foundation
+
+// MARK: - Baseline
+
+/// MuxFrameParser before the read cursor: copies metadata and payload out of
+/// the buffer and shifts the remainder down after every frame.
+final class FrontRemovalMuxFrameParser {
+    private var buffer = Data()
+
+    func feed(_ data: Data) -> [(metadata: MuxFrameMetadata, payload: Data?)] {
+        buffer.append(data)
+        var results: [(MuxFrameMetadata, Data?)] = []
+
+        while true {
+            guard buffer.count >= 2 else { break }
+            let metaLen = Int(UInt16(buffer[0]) << 8 | UInt16(buffer[1]))
+            guard buffer.count >= 2 + metaLen else { break }
+
+            guard let (metadata, _) = MuxFrameMetadata.decode(from: Data(buffer[2..<(2 + metaLen)])) else {
+                buffer.removeAll()
+                break
+            }
+
+            var consumed = 2 + metaLen
+            var payload: Data?
+            if metadata.option.contains(.data) {
+                guard buffer.count >= consumed + 2 else { break }
+                let payloadLen = Int(UInt16(buffer[consumed]) << 8 | UInt16(buffer[consumed + 1]))
+                consumed += 2
+                guard buffer.count >= consumed + payloadLen else { break }
+                if payloadLen > 0 {
+                    payload = Data(buffer[consumed..<(consumed + payloadLen)])
+                }
+                consumed += payloadLen
+            }
+
+            results.append((metadata, payload))
+            buffer.removeSubrange(0..<consumed)
+        }
+
+        return results
+    }
+}
+
+// MARK: - Benchmark
+
+@main
+struct MuxParserBench {
+    static func usage() {
+        FileHandle.standardError.write("""
+            usage: mux_parser_bench [-f frames] [-s payload] [-r read] [-n iterations]
+              -f  frames in the stream (default 10000)
+              -s  payload bytes per frame (default 64)
+              -r  bytes per read fed to the parser (default 16384)
+              -n  passes over the stream (default 20)
+
+            """.data(using: .utf8)!)
+    }
+
+    static func now() -> UInt64 {
+        DispatchTime.now().uptimeNanoseconds
+    }
+
+    static func report(_ name: String, frames: Int, bytes: Int, nanoseconds: UInt64) {
+        let secs = Double(nanoseconds) / 1e9
+        let rate = secs > 0 ? Double(frames) / secs : 0
+        let mbps = secs > 0 ? Double(bytes) / secs / 1e6 : 0
+        print(name.padding(toLength: 14, withPad: " ", startingAt: 0)
+              + String(format: "%12.0f frames/s %9.1f MB/s", rate, mbps))
+    }
+
+    /// Runs every pass over `reads` and checks each pass yields `frames` frames.
+    static func run(_ name: String, reads: [Data], frames: Int, bytes: Int, iterations: Int,
+                    feed: () -> (Data) -> [(metadata: MuxFrameMetadata, payload: Data?)]) {
+        let t0 = now()
+        for _ in 0..<iterations {
+            let parse = feed()
+            var parsed = 0
+            for read in reads {
+                parsed += parse(read).count
+            }
+            precondition(parsed == frames, "\(name): parsed \(parsed) of \(frames) frames")
+        }
+        report(name, frames: frames * iterations, bytes: bytes * iterations, nanoseconds: now() - t0)
+    }
+
+    static func main() {
+        var frames = 10_000
+        var payloadSize = 64
+        var readSize = 16384
+        var iterations = 20
+
+        var args = CommandLine.arguments.dropFirst()
+        while let flag = args.popFirst() {
+            guard flag != "-h" else { usage(); exit(0) }
+            guard let value = args.popFirst().flatMap({ Int($0) }) else { usage(); exit(1) }
+            switch flag {
+            case "-f": frames = value
+            case "-s": payloadSize = value
+            case "-r": readSize = value
+            case "-n": iterations = value
+            default: usage(); exit(1)
+            }
+        }
+        guard frames > 0, (0...65535).contains(payloadSize), readSize > 0, iterations > 0 else {
+            usage()
+            exit(1)
+        }
+
+        var stream = Data()
+        let payload = Data(repeating: 0xA5, count: payloadSize)
+        for i in 0..<frames {
+            let metadata = MuxFrameMetadata(sessionID: UInt16(1 + i % 64), status: .keep, option: .data)
+            stream.append(encodeMuxFrame(metadata: metadata, payload: payload))
+        }
+
+        // Each read gets its own storage, like data handed up by the transport
+        let reads = stride(from: 0, to: stream.count, by: readSize).map {
+            Data(stream[$0..<min($0 + readSize, stream.count)])
+        }
+
+        print("frames \(frames)  payload \(payloadSize) B  read \(readSize) B  stream \(stream.count) B  passes \(iterations)")
+        run("cursor", reads: reads, frames: frames, bytes: stream.count, iterations: iterations) {
+            let parser = MuxFrameParser()
+            return parser.feed
+        }
+        run("front-removal", reads: reads, frames: frames, bytes: stream.count, iterations: iterations) {
+            let parser = FrontRemovalMuxFrameParser()
+            return parser.feed
+        }
+    }
+}
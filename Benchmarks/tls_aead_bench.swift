@@ -0,0 +1,151 @@
+//
+//  tls_aead_bench.swift
+//  Benchmarks
+//
+//  Microbenchmark for the TLS 1.3 record AEADs. Seals and opens Application
+//  Data records of the same payload sizes with AES-128-GCM, AES-256-GCM and
+//  ChaCha20-Poly1305 the way TLSRecordConnection does (record header as AAD,
+//  per-record nonce from the static IV and sequence number), reporting
+//  records/s and MB/s for each direction.
+//
+//  CryptoKit only, so it runs outside the CMake build:
+//    swiftc -O Benchmarks/tls_aead_bench.swift -o tls_aead_bench
+//
+//  Usage: tls_aead_bench [-n records] [-s size[,size...]]
+//
+
+import CryptoKit
+import Foundation
+
+// MARK: - AEADs
+
+enum Suite: CaseIterable {
+    case aes128GCM, aes256GCM, chaCha20Poly1305
+
+    var name: String {
+        switch self {
+        case .aes128GCM: return "aes128gcm"
+        case .aes256GCM: return "aes256gcm"
+        case .chaCha20Poly1305: return "chacha20"
+        }
+    }
+
+    var keyBits: Int { self == .aes128GCM ? 128 : 256 }
+
+    func seal(_ plaintext: Data, key: SymmetricKey, nonce: Data, aad: Data) throws -> (Data, Data) {
+        switch self {
+        case .aes128GCM, .aes256GCM:
+            let box = try AES.GCM.seal(plaintext, using: key, nonce: AES.GCM.Nonce(data: nonce), authenticating: aad)
+            return (box.ciphertext, box.tag)
+        case .chaCha20Poly1305:
+            let box = try ChaChaPoly.seal(plaintext, using: key, nonce: ChaChaPoly.Nonce(data: nonce), authenticating: aad)
+            return (box.ciphertext, box.tag)
+        }
+    }
+
+    func open(_ ciphertext: Data, tag: Data, key: SymmetricKey, nonce: Data, aad: Data) throws -> Data {
+        switch self {
+        case .aes128GCM, .aes256GCM:
+            let box = try AES.GCM.SealedBox(nonce: AES.GCM.Nonce(data: nonce), ciphertext: ciphertext, tag: tag)
+            return try AES.GCM.open(box, using: key, authenticating: aad)
+        case .chaCha20Poly1305:
+            let box = try ChaChaPoly.SealedBox(nonce: ChaChaPoly.Nonce(data: nonce), ciphertext: ciphertext, tag: tag)
+            return try ChaChaPoly.open(box, using: key, authenticating: aad)
+        }
+    }
+}
+
+// MARK: - Records
+
+let iv = Data((1...12).map { UInt8($0) })
+
+func nonce(for seqNum: UInt64) -> Data {
+    var nonce = iv
+    for i in 0..<8 {
+        nonce[4 + i] ^= UInt8(truncatingIfNeeded: seqNum >> (56 - 8 * i))
+    }
+    return nonce
+}
+
+func header(for payloadSize: Int) -> Data {
+    let len = payloadSize + 1 + 16 // inner content type + tag
+    return Data([0x17, 0x03, 0x03, UInt8(len >> 8), UInt8(len & 0xFF)])
+}
+
+func now() -> UInt64 {
+    DispatchTime.now().uptimeNanoseconds
+}
+
+func report(_ suite: Suite, _ direction: String, size: Int, records: Int, nanoseconds: UInt64) {
+    let secs = Double(nanoseconds) / 1e9
+    let rate = secs > 0 ? Double(records) / secs : 0
+    let label = "\(suite.name) \(direction)".padding(toLength: 16, withPad: " ", startingAt: 0)
+    print(label + String(format: "%6d B %12.0f records/s %9.1f MB/s", size, rate, rate * Double(size) / 1e6))
+}
+
+func run(_ suite: Suite, size: Int, records: Int) throws {
+    let key = SymmetricKey(size: SymmetricKeySize(bitCount: suite.keyBits))
+    var inner = Data(repeating: 0xA5, count: size)
+    inner.append(0x17) // Application Data content type
+    let aad = header(for: size)
+
+    // The open pass cycles over the last `window` sealed records
+    let window = 64
+    var sealed = [(Data, Data)](repeating: (Data(), Data()), count: window)
+    var t0 = now()
+    for seq in 0..<records {
+        sealed[seq % window] = try suite.seal(inner, key: key, nonce: nonce(for: UInt64(seq % window)), aad: aad)
+    }
+    report(suite, "seal", size: size, records: records, nanoseconds: now() - t0)
+
+    t0 = now()
+    for seq in 0..<records {
+        let (ciphertext, tag) = sealed[seq % window]
+        let plaintext = try suite.open(ciphertext, tag: tag, key: key, nonce: nonce(for: UInt64(seq % window)), aad: aad)
+        precondition(plaintext.count == inner.count)
+    }
+    report(suite, "open", size: size, records: records, nanoseconds: now() - t0)
+}
+
+// MARK: - Main
+
+func usage() {
+    FileHandle.standardError.write("""
+        usage: tls_aead_bench [-n records] [-s size[,size...]]
+          -n  records per run (default 100000)
+          -s  record payload sizes in bytes, at most 16384 (default 64,1400,16384)
+
+        """.data(using: .utf8)!)
+}
+
+var records = 100_000
+var sizes = [64, 1400, 16384]
+
+var args = CommandLine.arguments.dropFirst()
+while let flag = args.popFirst() {
+    switch flag {
+    case "-n":
+        guard let value = args.popFirst().flatMap({ Int($0) }) else { usage(); exit(1) }
+        records = value
+    case "-s":
+        guard let value = args.popFirst() else { usage(); exit(1) }
+        sizes = value.split(separator: ",").compactMap { Int($0) }
+    case "-h":
+        usage()
+        exit(0)
+    default:
+        usage()
+        exit(1)
+    }
+}
+guard records > 0, !sizes.isEmpty, sizes.allSatisfy({ (0...16384).contains($0) }) else {
+    usage()
+    exit(1)
+}
+
+print("records \(records)  sizes \(sizes.map(String.init).joined(separator: ","))")
+for size in sizes {
+    for suite in Suite.allCases {
+        try run(suite, size: size, records: records)
+    }
+}
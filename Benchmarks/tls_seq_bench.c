@@ -0,0 +1,240 @@
+//
+//  tls_seq_bench.c
+//  Benchmarks
+//
+//  Microbenchmark for the sequence-number handling in TLSRecordConnection,
+//  before and after seqLock was dropped, reporting records/s for each path:
+//
+//    seal   sealRecords: one reservation per write covering its 16 KiB
+//           records; a lock around the counter before, one atomic add
+//           (tls_seq_reserve) after
+//    open   processBuffer: one number per Application Data record; a lock
+//           per record before, a local counter written back once per batch
+//           after (the receive stage already holds receiveLock)
+//
+//  Each record derives its nonce and, unless -s 0, copies its payload once,
+//  standing in for the staging copy into the output buffer. The AEAD itself
+//  is not modelled; Benchmarks/tls_aead_bench.swift measures it.
+//
+//  Usage: tls_seq_bench [-n records] [-w write] [-r batch] [-s record] [-t threads]
+//
+
+#include "CPacket.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <os/lock.h>
+#endif
+
+#define MAX_RECORD_PLAINTEXT 16384
+
+/* ========================================================================
+ *  Lock (os_unfair_lock where UnfairLock uses it, a mutex elsewhere)
+ * ======================================================================== */
+
+#ifdef __APPLE__
+static os_unfair_lock s_lock = OS_UNFAIR_LOCK_INIT;
+static void seq_lock(void)   { os_unfair_lock_lock(&s_lock); }
+static void seq_unlock(void) { os_unfair_lock_unlock(&s_lock); }
+#else
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static void seq_lock(void)   { pthread_mutex_lock(&s_lock); }
+static void seq_unlock(void) { pthread_mutex_unlock(&s_lock); }
+#endif
+
+/* ========================================================================
+ *  Per-record work
+ * ======================================================================== */
+
+static const uint8_t s_iv[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+static long     s_records = 2000000;
+static long     s_write = MAX_RECORD_PLAINTEXT;
+static int      s_batch = 4;
+static long     s_record_size = MAX_RECORD_PLAINTEXT;
+static uint64_t s_counter = 0;
+
+/* Keeps the nonce work from being optimized away */
+static volatile uint8_t s_sink;
+
+typedef struct {
+    long     records;
+    uint8_t *src;
+    uint8_t *dst;
+} worker_args;
+
+static void process_record(const worker_args *w, uint64_t seq) {
+    uint8_t nonce[12];
+    memcpy(nonce, s_iv, sizeof(nonce));
+    xor_nonce_with_seq(nonce, seq);
+    if (s_record_size > 0) {
+        memcpy(w->dst, w->src, (size_t)s_record_size);
+    }
+    s_sink = nonce[11];
+}
+
+/// Records sealRecords makes from one write of s_write bytes
+static long records_per_write(void) {
+    long n = (s_write + MAX_RECORD_PLAINTEXT - 1) / MAX_RECORD_PLAINTEXT;
+    return n > 0 ? n : 1;
+}
+
+/* ========================================================================
+ *  Seal: one reservation per write
+ * ======================================================================== */
+
+static void *seal_locked(void *arg) {
+    const worker_args *w = arg;
+    long per_write = records_per_write();
+    for (long i = 0; i < w->records; i += per_write) {
+        long count = w->records - i < per_write ? w->records - i : per_write;
+        seq_lock();
+        uint64_t first = s_counter;
+        s_counter += (uint64_t)count;
+        seq_unlock();
+        for (long j = 0; j < count; j++) {
+            process_record(w, first + (uint64_t)j);
+        }
+    }
+    return NULL;
+}
+
+static void *seal_atomic(void *arg) {
+    const worker_args *w = arg;
+    long per_write = records_per_write();
+    for (long i = 0; i < w->records; i += per_write) {
+        long count = w->records - i < per_write ? w->records - i : per_write;
+        uint64_t first = tls_seq_reserve(&s_counter, (uint64_t)count);
+        for (long j = 0; j < count; j++) {
+            process_record(w, first + (uint64_t)j);
+        }
+    }
+    return NULL;
+}
+
+/* ========================================================================
+ *  Open: one number per record, batches of s_batch records
+ * ======================================================================== */
+
+static void *open_locked(void *arg) {
+    const worker_args *w = arg;
+    for (long i = 0; i < w->records; i++) {
+        seq_lock();
+        uint64_t seq = s_counter++;
+        seq_unlock();
+        process_record(w, seq);
+    }
+    return NULL;
+}
+
+static void *open_local(void *arg) {
+    const worker_args *w = arg;
+    for (long i = 0; i < w->records; i += s_batch) {
+        long count = w->records - i < s_batch ? w->records - i : s_batch;
+        uint64_t seq = s_counter;
+        for (long j = 0; j < count; j++) {
+            process_record(w, seq++);
+        }
+        s_counter = seq;
+    }
+    return NULL;
+}
+
+/* ========================================================================
+ *  Runner
+ * ======================================================================== */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double run(const char *name, void *(*worker)(void *), int threads) {
+    pthread_t tids[64];
+    worker_args args[64];
+    size_t buf_size = s_record_size > 0 ? (size_t)s_record_size : 1;
+    s_counter = 0;
+
+    for (int i = 0; i < threads; i++) {
+        args[i].records = s_records / threads;
+        args[i].src = calloc(1, buf_size);
+        args[i].dst = calloc(1, buf_size);
+        if (!args[i].src || !args[i].dst) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double secs = (double)(now_ns() - t0) / 1e9;
+
+    for (int i = 0; i < threads; i++) {
+        free(args[i].src);
+        free(args[i].dst);
+    }
+
+    long total = (s_records / threads) * threads;
+    double rate = secs > 0 ? (double)total / secs : 0.0;
+    printf("%-12s %10ld records %14.0f records/s %9.2f ns/record  seq %llu\n",
+           name, total, rate, secs * 1e9 / (double)total, (unsigned long long)s_counter);
+    return rate;
+}
+
+/* ========================================================================
+ *  Main
+ * ======================================================================== */
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-n records] [-w write] [-r batch] [-s record] [-t threads]\n"
+            "  -n  records per run (default 2000000)\n"
+            "  -w  bytes per sealRecords write; one number per 16 KiB record (default 16384)\n"
+            "  -r  records per processBuffer batch (default 4)\n"
+            "  -s  payload bytes copied per record, 0 for sequence numbers only (default 16384)\n"
+            "  -t  threads sealing concurrently (default 1, max 64); open runs on one,\n"
+            "      as the receive stage does\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    int threads = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:r:s:t:h")) != -1) {
+        switch (opt) {
+        case 'n': s_records = atol(optarg); break;
+        case 'w': s_write = atol(optarg); break;
+        case 'r': s_batch = atoi(optarg); break;
+        case 's': s_record_size = atol(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (s_records < 1 || s_write < 0 || s_batch < 1 || s_record_size < 0 ||
+        threads < 1 || threads > 64 || s_records < threads) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("records %ld  write %ld B (%ld per reservation)  batch %d  record %ld B  threads %d\n",
+           s_records, s_write, records_per_write(), s_batch, s_record_size, threads);
+    double before = run("seal-locked", seal_locked, threads);
+    double after = run("seal-atomic", seal_atomic, threads);
+    printf("seal: %.2fx\n", before > 0 ? after / before : 0.0);
+    before = run("open-locked", open_locked, 1);
+    after = run("open-local", open_local, 1);
+    printf("open: %.2fx\n", before > 0 ? after / before : 0.0);
+    return 0;
+}
@@ -13,31 +13,39 @@ import Foundation
 ///
 /// **Design** (mirrors Xray-core `common/signal/timer.go`):
 /// - A boolean flag is set by ``update()`` (non-blocking, safe to call often).
-/// - A `DispatchSourceTimer` fires every *timeout* seconds and checks the flag.
-///   If the flag is still clear → inactivity → callback.
+/// - An entry in a shared ``TimingWheel`` expires every *timeout* seconds and
+///   checks the flag. If the flag is still clear → inactivity → callback.
 /// - ``setTimeout(_:)`` replaces the interval (used to switch between
 ///   `ConnectionIdle` and direction-only timeouts).
 ///
-/// All operations must run on the provided serial queue.
+/// All operations must run on the wheel's serial queue.
 class ActivityTimer {
-    private var timer: DispatchSourceTimer?
+    private let wheel: TimingWheel
+    private var entry: TimingWheel.Entry?
+    private var timeout: TimeInterval
     private var hasActivity = false
-    private let queue: DispatchQueue
     private let onTimeout: () -> Void
     private var cancelled = false
 
     /// Creates and starts the timer.
     ///
     /// - Parameters:
-    ///   - queue:     Serial queue for all timer operations.
+    ///   - wheel:     Timing wheel that drives the checks.
     ///   - timeout:   Inactivity interval in seconds.
     ///   - onTimeout: Fired once when no ``update()`` call is observed within
     ///                a full interval.  The timer is cancelled before the
     ///                callback is invoked.
-    init(queue: DispatchQueue, timeout: TimeInterval, onTimeout: @escaping () -> Void) {
-        self.queue = queue
+    init(wheel: TimingWheel, timeout: TimeInterval, onTimeout: @escaping () -> Void) {
+        self.wheel = wheel
+        self.timeout = timeout
         self.onTimeout = onTimeout
-        startTimer(timeout: timeout)
+        let entry = wheel.makeEntry { [weak self] in self?.check() }
+        self.entry = entry
+        wheel.schedule(entry, after: timeout)
+    }
+
+    deinit {
+        if let entry { wheel.cancel(entry) }
     }
 
     /// Signals that activity has occurred.
@@ -49,39 +57,34 @@ class ActivityTimer {
     ///
     /// Used to switch from `ConnectionIdle` to `DownlinkOnly` / `UplinkOnly`.
     func setTimeout(_ timeout: TimeInterval) {
-        guard !cancelled else { return }
-        timer?.cancel()
+        guard !cancelled, let entry else { return }
         if timeout <= 0 {
             cancel()
             onTimeout()
             return
         }
         hasActivity = true
-        startTimer(timeout: timeout)
+        self.timeout = timeout
+        wheel.schedule(entry, after: timeout)
     }
 
     func cancel() {
         guard !cancelled else { return }
         cancelled = true
-        timer?.cancel()
-        timer = nil
+        if let entry { wheel.cancel(entry) }
+        entry = nil
     }
 
     // MARK: - Private
 
-    private func startTimer(timeout: TimeInterval) {
-        let newTimer = DispatchSource.makeTimerSource(queue: queue)
-        newTimer.schedule(deadline: .now() + timeout, repeating: timeout)
-        newTimer.setEventHandler { [weak self] in
-            guard let self, !self.cancelled else { return }
-            if self.hasActivity {
-                self.hasActivity = false
-            } else {
-                self.cancel()
-                self.onTimeout()
-            }
+    private func check() {
+        guard !cancelled, let entry else { return }
+        if hasActivity {
+            hasActivity = false
+            wheel.schedule(entry, after: timeout)
+        } else {
+            cancel()
+            onTimeout()
         }
-        newTimer.resume()
-        timer = newTimer
     }
 }
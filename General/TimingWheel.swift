@@ -0,0 +1,211 @@
+//
+//  TimingWheel.swift
+//  Anywhere
+//
+//  Hierarchical timing wheel for per-connection timeouts.
+//
+
+import Foundation
+
+/// Hierarchical timing wheel for coarse per-flow timeouts.
+///
+/// Scheduling, rescheduling and cancelling are O(1), so thousands of
+/// per-flow timeouts cost one list link each instead of one kernel timer
+/// source each. The wheel keeps time in ticks of ``tickInterval`` since its
+/// creation; the owner calls ``advance()`` at ``nextDeadline`` and whenever
+/// else it wakes up, and arms its own timer from ``scheduleObserver``.
+///
+/// **Layout** (same as the classic Linux timer wheel): level 0 has 256 slots
+/// of one tick each; levels 1–3 have 64 slots, each covering one full
+/// revolution of the level below. Entries too far out for level 0 sit in
+/// a coarser slot and are cascaded down when the lower level wraps. With a
+/// 250 ms tick level 0 spans 64 s and the wheel spans about 194 days; longer
+/// delays are clamped.
+///
+/// All operations must run on the owner's serial queue.
+final class TimingWheel {
+
+    /// A schedulable timeout. Created once per owner via ``makeEntry(_:)``
+    /// and rescheduled as often as needed.
+    final class Entry {
+        fileprivate let handler: () -> Void
+        fileprivate var deadline: UInt64 = 0
+        fileprivate var slot = -1
+        fileprivate var next: Entry?
+        fileprivate unowned(unsafe) var prev: Entry?
+
+        fileprivate init(handler: @escaping () -> Void) {
+            self.handler = handler
+        }
+
+        /// Whether the entry is waiting in the wheel.
+        var isScheduled: Bool { slot >= 0 }
+    }
+
+    private static let level0Bits: UInt64 = 8
+    private static let levelBits: UInt64 = 6
+    private static let level0Size = 1 << Int(level0Bits)
+    private static let levelSize = 1 << Int(levelBits)
+    private static let upperLevels = 3
+    private static let maxDelay: UInt64 = (1 << (level0Bits + levelBits * UInt64(upperLevels))) - 1
+
+    /// Wheel granularity in seconds.
+    let tickInterval: TimeInterval
+
+    /// Called with an entry's expiry time whenever one is scheduled, so the
+    /// owner can move its timer earlier.
+    var scheduleObserver: ((DispatchTime) -> Void)?
+
+    /// Number of scheduled entries.
+    private(set) var count = 0
+
+    private let tickNanoseconds: UInt64
+    private let epoch: UInt64
+    private var slots: [Entry?]
+    private var currentTick: UInt64 = 0
+
+    init(tickInterval: TimeInterval) {
+        self.tickInterval = tickInterval
+        self.tickNanoseconds = UInt64(tickInterval * 1_000_000_000)
+        self.epoch = DispatchTime.now().uptimeNanoseconds
+        self.slots = Array(repeating: nil, count: Self.level0Size + Self.levelSize * Self.upperLevels)
+    }
+
+    /// When the earliest entry may expire: the first occupied level-0 slot,
+    /// or the next cascade if there is none. `nil` when the wheel is empty.
+    var nextDeadline: DispatchTime? {
+        guard count > 0 else { return nil }
+        let mask = UInt64(Self.level0Size - 1)
+        var tick = currentTick + 1
+        while tick & mask != 0 && slots[Int(tick & mask)] == nil {
+            tick += 1
+        }
+        return time(ofTick: tick)
+    }
+
+    /// Creates an unscheduled entry whose handler runs on expiry. The handler
+    /// runs after the entry has left the wheel, so it may reschedule it.
+    func makeEntry(_ handler: @escaping () -> Void) -> Entry {
+        Entry(handler: handler)
+    }
+
+    /// Schedules `entry` to fire after `delay` seconds (rounded up to whole
+    /// ticks, at least one), replacing any earlier schedule.
+    func schedule(_ entry: Entry, after delay: TimeInterval) {
+        if entry.isScheduled {
+            unlink(entry)
+        } else {
+            count += 1
+        }
+        // An empty wheel has nothing to fire, so it can skip straight to now
+        let now = nowTick
+        if count == 1 { currentTick = now }
+        let ticks = UInt64(min(max(1, (delay / tickInterval).rounded(.up)), Double(Self.maxDelay)))
+        entry.deadline = min(max(now, currentTick) + ticks, currentTick + Self.maxDelay)
+        insert(entry)
+        scheduleObserver?(time(ofTick: entry.deadline))
+    }
+
+    func cancel(_ entry: Entry) {
+        guard entry.isScheduled else { return }
+        unlink(entry)
+        count -= 1
+    }
+
+    /// Unschedules every entry without firing it.
+    func removeAll() {
+        for i in slots.indices {
+            while let entry = slots[i] { unlink(entry) }
+        }
+        count = 0
+    }
+
+    /// Catches the wheel up with the current time, firing the entries that
+    /// are due.
+    func advance() {
+        let target = nowTick
+        while currentTick < target {
+            if count == 0 {
+                currentTick = target
+                break
+            }
+            step()
+        }
+    }
+
+    // MARK: - Private
+
+    private var nowTick: UInt64 {
+        (DispatchTime.now().uptimeNanoseconds - epoch) / tickNanoseconds
+    }
+
+    private func time(ofTick tick: UInt64) -> DispatchTime {
+        DispatchTime(uptimeNanoseconds: epoch + tick * tickNanoseconds)
+    }
+
+    /// Moves the wheel forward one tick and fires the entries that are due.
+    private func step() {
+        currentTick += 1
+
+        // Cascade coarser slots down whenever the level below wraps
+        if currentTick & UInt64(Self.level0Size - 1) == 0 {
+            for level in 0..<Self.upperLevels {
+                if cascade(level: level) != 0 { break }
+            }
+        }
+
+        let index = Int(currentTick & UInt64(Self.level0Size - 1))
+        while let entry = slots[index] {
+            unlink(entry)
+            count -= 1
+            entry.handler()
+        }
+    }
+
+    private func insert(_ entry: Entry) {
+        let delta = entry.deadline - currentTick
+        let index: Int
+        if delta < UInt64(Self.level0Size) {
+            index = Int(entry.deadline & UInt64(Self.level0Size - 1))
+        } else {
+            var level = 0
+            var shift = Self.level0Bits
+            while level < Self.upperLevels - 1 && delta >= (1 << (shift + Self.levelBits)) {
+                level += 1
+                shift += Self.levelBits
+            }
+            index = Self.level0Size + level * Self.levelSize
+                + Int((entry.deadline >> shift) & UInt64(Self.levelSize - 1))
+        }
+        entry.slot = index
+        entry.prev = nil
+        entry.next = slots[index]
+        slots[index]?.prev = entry
+        slots[index] = entry
+    }
+
+    private func unlink(_ entry: Entry) {
+        if let prev = entry.prev {
+            prev.next = entry.next
+        } else {
+            slots[entry.slot] = entry.next
+        }
+        entry.next?.prev = entry.prev
+        entry.next = nil
+        entry.prev = nil
+        entry.slot = -1
+    }
+
+    /// Re-inserts the entries of the current slot of upper `level` (0-based)
+    /// into finer slots. Returns that slot's index within its level.
+    private func cascade(level: Int) -> Int {
+        let shift = Self.level0Bits + Self.levelBits * UInt64(level)
+        let index = Int((currentTick >> shift) & UInt64(Self.levelSize - 1))
+        let slot = Self.level0Size + level * Self.levelSize + index
+        while let entry = slots[slot] {
+            unlink(entry)
+            insert(entry)
+        }
+        return index
+    }
+}
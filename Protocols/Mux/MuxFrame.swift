@@ -90,12 +90,13 @@ struct MuxFrameMetadata {
         return buf
     }
 
-    /// Decodes metadata from raw bytes.
+    /// Decodes metadata from raw bytes. `data` may be a slice; it is read in place.
     /// Returns `(metadata, bytesConsumed)` or `nil` if insufficient data.
     static func decode(from data: Data) -> (MuxFrameMetadata, Int)? {
         guard data.count >= 4 else { return nil }  // minimum: 2B id + 1B status + 1B option
 
-        var offset = 0
+        let end = data.endIndex
+        var offset = data.startIndex
         let sessionID = UInt16(data[offset]) << 8 | UInt16(data[offset + 1])
         offset += 2
 
@@ -113,13 +114,13 @@ struct MuxFrameMetadata {
 
         // New frames carry address info
         if status == .new {
-            guard data.count >= offset + 1 else { return nil }
+            guard end >= offset + 1 else { return nil }
             guard let network = MuxNetwork(rawValue: data[offset]) else { return nil }
             metadata.network = network
             offset += 1
 
             // Port (2B big-endian)
-            guard data.count >= offset + 2 else { return nil }
+            guard end >= offset + 2 else { return nil }
             metadata.targetPort = UInt16(data[offset]) << 8 | UInt16(data[offset + 1])
             offset += 2
 
@@ -129,13 +130,13 @@ struct MuxFrameMetadata {
             offset += addrLen
 
             // GlobalID for UDP (optional — only present with XUDP)
-            if network == .udp && data.count >= offset + 8 {
+            if network == .udp && end >= offset + 8 {
                 metadata.globalID = data[offset..<(offset + 8)]
                 offset += 8
             }
         }
 
-        return (metadata, offset)
+        return (metadata, offset - data.startIndex)
     }
 
     // MARK: - Address Encoding (port-first)
@@ -156,14 +157,15 @@ struct MuxFrameMetadata {
         }
     }
 
+    /// `offset` is an index into `data`, which may be a slice.
     private static func decodeAddress(from data: Data, offset: Int) -> (String, Int)? {
-        guard data.count > offset else { return nil }
+        guard data.endIndex > offset else { return nil }
         guard let addrType = MuxAddressType(rawValue: data[offset]) else { return nil }
         var pos = 1  // consumed addr_type byte
 
         switch addrType {
         case .ipv4:
-            guard data.count >= offset + pos + 4 else { return nil }
+            guard data.endIndex >= offset + pos + 4 else { return nil }
             let a = data[offset + pos]
             let b = data[offset + pos + 1]
             let c = data[offset + pos + 2]
@@ -171,15 +173,15 @@ struct MuxFrameMetadata {
             return ("\(a).\(b).\(c).\(d)", pos + 4)
 
         case .domain:
-            guard data.count >= offset + pos + 1 else { return nil }
+            guard data.endIndex >= offset + pos + 1 else { return nil }
             let domainLen = Int(data[offset + pos])
             pos += 1
-            guard data.count >= offset + pos + domainLen else { return nil }
+            guard data.endIndex >= offset + pos + domainLen else { return nil }
             let domain = String(data: data[(offset + pos)..<(offset + pos + domainLen)], encoding: .utf8) ?? ""
             return (domain, pos + domainLen)
 
         case .ipv6:
-            guard data.count >= offset + pos + 16 else { return nil }
+            guard data.endIndex >= offset + pos + 16 else { return nil }
             var parts = [String]()
             for i in stride(from: 0, to: 16, by: 2) {
                 let val = UInt16(data[offset + pos + i]) << 8 | UInt16(data[offset + pos + i + 1])
@@ -260,54 +262,71 @@ func encodeMuxFrame(metadata: MuxFrameMetadata, payload: Data?) -> Data {
 // MARK: - Streaming Frame Parser
 
 /// Streaming parser that buffers partial reads and emits complete frames.
+///
+/// Frames are parsed in place behind a read cursor: metadata is decoded from
+/// the buffer and payloads are returned as slices sharing its storage. Only
+/// the trailing partial frame is copied, once per `feed`.
 class MuxFrameParser {
     private var buffer = Data()
 
     /// Feeds raw bytes into the parser and returns any complete frames.
     func feed(_ data: Data) -> [(metadata: MuxFrameMetadata, payload: Data?)] {
-        buffer.append(data)
+        if buffer.isEmpty {
+            // Nothing pending — parse the read itself
+            buffer = data
+        } else {
+            buffer.append(data)
+        }
         var results: [(MuxFrameMetadata, Data?)] = []
 
+        let end = buffer.endIndex
+        var cursor = buffer.startIndex
+
         while true {
             // Need at least 2 bytes for metadata length
-            guard buffer.count >= 2 else { break }
+            guard end - cursor >= 2 else { break }
 
-            let metaLen = Int(UInt16(buffer[0]) << 8 | UInt16(buffer[1]))
+            let metaLen = Int(UInt16(buffer[cursor]) << 8 | UInt16(buffer[cursor + 1]))
+            let metaStart = cursor + 2
 
             // Need full metadata
-            guard buffer.count >= 2 + metaLen else { break }
+            guard end - metaStart >= metaLen else { break }
 
-            let metaData = buffer[2..<(2 + metaLen)]
-            guard let (metadata, _) = MuxFrameMetadata.decode(from: Data(metaData)) else {
+            guard let (metadata, _) = MuxFrameMetadata.decode(from: buffer[metaStart..<(metaStart + metaLen)]) else {
                 // Corrupt frame — discard buffer
-                buffer.removeAll()
-                break
+                buffer = Data()
+                return results
             }
 
-            var consumed = 2 + metaLen
+            var frameEnd = metaStart + metaLen
             var payload: Data?
 
             if metadata.option.contains(.data) {
                 // Need 2 bytes for payload length
-                guard buffer.count >= consumed + 2 else { break }
+                guard end - frameEnd >= 2 else { break }
 
-                let payloadLen = Int(UInt16(buffer[consumed]) << 8 | UInt16(buffer[consumed + 1]))
-                consumed += 2
+                let payloadLen = Int(UInt16(buffer[frameEnd]) << 8 | UInt16(buffer[frameEnd + 1]))
+                frameEnd += 2
 
                 // Need full payload
-                guard buffer.count >= consumed + payloadLen else {
-                    // Revert — not enough payload data yet
-                    break
-                }
+                guard end - frameEnd >= payloadLen else { break }
 
                 if payloadLen > 0 {
-                    payload = Data(buffer[consumed..<(consumed + payloadLen)])
+                    payload = buffer[frameEnd..<(frameEnd + payloadLen)]
                 }
-                consumed += payloadLen
+                frameEnd += payloadLen
             }
 
             results.append((metadata, payload))
-            buffer.removeSubrange(0..<consumed)
+            cursor = frameEnd
+        }
+
+        // Compact: keep only the partial frame. Emitted slices hold on to the
+        // old storage, so copying the tail beats shifting it in place.
+        if cursor == end {
+            buffer = Data()
+        } else if cursor != buffer.startIndex {
+            buffer = Data(buffer[cursor..<end])
         }
 
         return results
@@ -2,7 +2,7 @@
 //  XUDP.swift
 //  Anywhere
 //
-//  XUDP GlobalID generation using blake3 keyed hash.
+//  XUDP GlobalID generation using blake3 keyed hash (CXUDP.c).
 //  Matching Xray-core common/xudp/xudp.go.
 //
 
@@ -18,23 +18,32 @@ enum XUDP {
         return key
     }()
 
+    /// GlobalID generator keyed once with `baseKey`, caching recent sources.
+    private static let globalIDCache: OpaquePointer = baseKey.withUnsafeBufferPointer { keyPtr in
+        xudp_global_id_cache_create(keyPtr.baseAddress!)!
+    }
+    private static let globalIDLock = UnfairLock()
+
     /// Generate 8-byte GlobalID from source address using blake3 keyed hash.
     /// Matching Xray-core xudp.go:55-57:
     ///   h := blake3.New(8, BaseKey)
     ///   h.Write([]byte(inbound.Source.String()))
-    /// The source string format is "udp:host:port" matching Xray-core's
-    /// net.Destination.String() for UDP sources.
-    static func generateGlobalID(sourceAddress: String) -> Data {
-        var hasher = blake3_hasher()
-        baseKey.withUnsafeBufferPointer { keyPtr in
-            blake3_hasher_init_keyed(&hasher, keyPtr.baseAddress!)
-        }
-        let sourceBytes = Array(sourceAddress.utf8)
-        sourceBytes.withUnsafeBufferPointer { srcPtr in
-            blake3_hasher_update(&hasher, srcPtr.baseAddress!, sourceBytes.count)
+    /// The hashed string is "udp:host:port" matching Xray-core's
+    /// net.Destination.String() for UDP sources; xudp_global_id formats it
+    /// from the raw address and skips the hash for recently seen sources.
+    ///
+    /// - Parameters:
+    ///   - sourceIP: Source address bytes in network order (4 or 16).
+    ///   - isIPv6: Whether `sourceIP` is IPv6.
+    ///   - sourcePort: Source port.
+    static func generateGlobalID(sourceIP: UnsafeRawPointer, isIPv6: Bool, sourcePort: UInt16) -> Data {
+        var globalID = Data(count: Int(XUDP_GLOBAL_ID_LEN))
+        globalID.withUnsafeMutableBytes { out in
+            globalIDLock.withLock {
+                xudp_global_id(globalIDCache, sourceIP, isIPv6 ? 1 : 0, sourcePort,
+                               out.baseAddress!.assumingMemoryBound(to: UInt8.self))
+            }
         }
-        var output = [UInt8](repeating: 0, count: 8)
-        blake3_hasher_finalize(&hasher, &output, 8)
-        return Data(output)
+        return globalID
     }
 }
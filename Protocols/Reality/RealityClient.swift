@@ -446,8 +446,7 @@ class RealityClient {
                     let seqNum = serverHandshakeSeqNum
                     let decrypted = try TLSRecordCrypto.decryptRecord(
                         ciphertext: ciphertext,
-                        key: keys.serverKey,
-                        iv: keys.serverIV,
+                        cipher: keys.serverCipher,
                         seqNum: seqNum,
                         recordHeader: recordHeader
                     )
@@ -503,7 +502,8 @@ class RealityClient {
                     clientKey: appKeys.clientKey,
                     clientIV: appKeys.clientIV,
                     serverKey: appKeys.serverKey,
-                    serverIV: appKeys.serverIV
+                    serverIV: appKeys.serverIV,
+                    cipherSuite: appKeys.cipherSuite
                 )
                 realityConnection.connection = self.connection
                 self.connection = nil
@@ -561,8 +561,7 @@ class RealityClient {
         do {
             let encrypted = try TLSRecordCrypto.encryptHandshakeRecord(
                 plaintext: finishedMsg,
-                key: keys.clientKey,
-                iv: keys.clientIV,
+                cipher: keys.clientCipher,
                 seqNum: 0
             )
 
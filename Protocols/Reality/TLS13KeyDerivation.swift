@@ -22,6 +22,22 @@ struct TLSHandshakeKeys {
     let serverKey: Data
     let serverIV: Data
     let clientTrafficSecret: Data
+    let cipherSuite: UInt16
+
+    /// Per-direction cipher state, set up once for the handshake
+    let clientCipher: TLSCipherContext
+    let serverCipher: TLSCipherContext
+
+    init(clientKey: Data, clientIV: Data, serverKey: Data, serverIV: Data, clientTrafficSecret: Data, cipherSuite: UInt16) {
+        self.clientKey = clientKey
+        self.clientIV = clientIV
+        self.serverKey = serverKey
+        self.serverIV = serverIV
+        self.clientTrafficSecret = clientTrafficSecret
+        self.cipherSuite = cipherSuite
+        self.clientCipher = TLSCipherContext(key: clientKey, iv: clientIV, cipherSuite: cipherSuite)
+        self.serverCipher = TLSCipherContext(key: serverKey, iv: serverIV, cipherSuite: cipherSuite)
+    }
 }
 
 /// TLS 1.3 application traffic keys
@@ -30,6 +46,7 @@ struct TLSApplicationKeys {
     let clientIV: Data
     let serverKey: Data
     let serverIV: Data
+    let cipherSuite: UInt16
 }
 
 /// TLS 1.3 key derivation utilities
@@ -48,7 +65,8 @@ struct TLS13KeyDerivation {
     /// Get encryption key length based on cipher suite
     var keyLength: Int {
         switch cipherSuite {
-        case TLSCipherSuite.TLS_AES_256_GCM_SHA384:
+        case TLSCipherSuite.TLS_AES_256_GCM_SHA384,
+             TLSCipherSuite.TLS_CHACHA20_POLY1305_SHA256:
             return 32
         default: // TLS_AES_128_GCM_SHA256
             return 16
@@ -156,7 +174,8 @@ struct TLS13KeyDerivation {
             clientIV: clientIV,
             serverKey: serverKey,
             serverIV: serverIV,
-            clientTrafficSecret: clientHTS
+            clientTrafficSecret: clientHTS,
+            cipherSuite: cipherSuite
         )
 
         return (handshakeSecret, keys)
@@ -180,7 +199,8 @@ struct TLS13KeyDerivation {
             clientKey: clientKey,
             clientIV: clientIV,
             serverKey: serverKey,
-            serverIV: serverIV
+            serverIV: serverIV,
+            cipherSuite: cipherSuite
         )
     }
 
@@ -15,9 +15,9 @@ private let logger = Logger(subsystem: "com.argsment.Anywhere.Network-Extension"
 
 /// TLS 1.3 application-layer record encryption/decryption wrapper.
 ///
-/// Encrypts outgoing data into TLS Application Data records using AES-128-GCM (or AES-256-GCM
-/// depending on the negotiated cipher suite) and decrypts incoming records. Sequence numbers
-/// are tracked independently for client and server directions.
+/// Encrypts outgoing data into TLS Application Data records using the AEAD of the negotiated
+/// cipher suite (AES-128-GCM, AES-256-GCM or ChaCha20-Poly1305) and decrypts incoming records.
+/// Sequence numbers are tracked independently for client and server directions.
 ///
 /// Supports a "direct" mode (``receiveRaw(completion:)`` / ``sendRaw(data:completion:)``)
 /// that bypasses encryption for Vision direct-copy transitions.
@@ -28,20 +28,15 @@ class TLSRecordConnection {
     /// The underlying BSD socket.
     var connection: BSDSocket?
 
-    // TLS encryption keys
-    private let clientKey: Data
-    private let clientIV: Data
-    private let serverKey: Data
-    private let serverIV: Data
+    // Per-direction cipher state, set up once per traffic key
+    private let clientCipher: TLSCipherContext
+    private let serverCipher: TLSCipherContext
 
-    // Cached symmetric keys to avoid repeated creation per encrypt/decrypt
-    private let clientSymmetricKey: SymmetricKey
-    private let serverSymmetricKey: SymmetricKey
-
-    // Sequence numbers
-    private var clientSeqNum: UInt64 = 0
+    // Sequence numbers. The server counter belongs to the receive stage and is
+    // only touched under receiveLock; client numbers are reserved a batch at a
+    // time with one atomic add (tls_seq_reserve).
+    private let clientSeqNum = UnsafeMutablePointer<UInt64>.allocate(capacity: 1)
     private var serverSeqNum: UInt64 = 0
-    private let seqLock = UnfairLock()
 
     // Receive buffer for batching reads
     private var receiveBuffer = Data(capacity: 256 * 1024)
@@ -56,18 +51,20 @@ class TLSRecordConnection {
     ///   - clientIV: The client-to-server initialization vector.
     ///   - serverKey: The server-to-client encryption key.
     ///   - serverIV: The server-to-client initialization vector.
-    init(clientKey: Data, clientIV: Data, serverKey: Data, serverIV: Data) {
-        self.clientKey = clientKey
-        self.clientIV = clientIV
-        self.serverKey = serverKey
-        self.serverIV = serverIV
-        self.clientSymmetricKey = SymmetricKey(data: clientKey)
-        self.serverSymmetricKey = SymmetricKey(data: serverKey)
+    ///   - cipherSuite: The negotiated TLS 1.3 cipher suite.
+    init(clientKey: Data, clientIV: Data, serverKey: Data, serverIV: Data, cipherSuite: UInt16) {
+        self.clientCipher = TLSCipherContext(key: clientKey, iv: clientIV, cipherSuite: cipherSuite)
+        self.serverCipher = TLSCipherContext(key: serverKey, iv: serverIV, cipherSuite: cipherSuite)
+        self.clientSeqNum.initialize(to: 0)
+    }
+
+    deinit {
+        clientSeqNum.deallocate()
     }
 
     // MARK: - Send (Encrypted)
 
-    /// Sends data through the Reality tunnel, encrypting it as a TLS Application Data record.
+    /// Sends data through the Reality tunnel, encrypting it as TLS Application Data records.
     ///
     /// - Parameters:
     ///   - data: The plaintext data to encrypt and send.
@@ -78,13 +75,8 @@ class TLSRecordConnection {
             return
         }
         do {
-            seqLock.lock()
-            let seqNum = clientSeqNum
-            clientSeqNum += 1
-            seqLock.unlock()
-
-            let record = try encryptAndBuildTLSRecord(plaintext: data, seqNum: seqNum)
-            connection.send(data: record, completion: completion)
+            let records = try sealRecords(plaintext: data)
+            connection.send(data: records, completion: completion)
         } catch {
             logger.error("[Reality] Encryption error: \(error.localizedDescription, privacy: .public)")
             completion(error)
@@ -97,13 +89,8 @@ class TLSRecordConnection {
     func send(data: Data) {
         guard let connection else { return }
         do {
-            seqLock.lock()
-            let seqNum = clientSeqNum
-            clientSeqNum += 1
-            seqLock.unlock()
-
-            let record = try encryptAndBuildTLSRecord(plaintext: data, seqNum: seqNum)
-            connection.send(data: record)
+            let records = try sealRecords(plaintext: data)
+            connection.send(data: records)
         } catch {
             logger.error("[Reality] Encryption error: \(error.localizedDescription, privacy: .public)")
         }
@@ -280,77 +267,68 @@ class TLSRecordConnection {
 
     /// Processes all complete TLS records in the receive buffer.
     ///
-    /// Returns batched decrypted data from multiple records to reduce callback overhead.
+    /// Records are parsed with a cursor over the buffer and opened straight
+    /// from it, with no per-record header/body copies; plaintext is appended
+    /// to one output buffer sized for the whole batch, and the consumed bytes
+    /// are removed from the receive buffer once at the end.
     /// Must be called while holding `receiveLock`.
     private func processBuffer() -> BufferResult? {
-        if receiveBuffer.count == 0 {
+        if receiveBuffer.isEmpty {
             return nil
         }
 
         var batchedData = Data(capacity: receiveBuffer.count)
         var hasError: Error? = nil
         var recordsProcessed = 0
-        var failedRecordData: Data? = nil
-
-        while receiveBuffer.count >= 5 {
-            var contentType: UInt8 = 0
-            var recordLen: UInt16 = 0
-
-            let hasHeader = receiveBuffer.withUnsafeBytes { ptr -> Bool in
-                return parse_tls_header(
-                    ptr.baseAddress!.assumingMemoryBound(to: UInt8.self),
-                    ptr.count,
-                    &contentType,
-                    &recordLen
-                ) != 0
-            }
-
-            guard hasHeader else { break }
-
-            let totalLen = 5 + Int(recordLen)
-            guard receiveBuffer.count >= totalLen else { break }
-
-            let headerStart = receiveBuffer.startIndex
-            let headerEnd = headerStart + 5
-            let bodyEnd = headerStart + totalLen
-
-            let header = Data(receiveBuffer[headerStart..<headerEnd])
-            let body = Data(receiveBuffer[headerEnd..<bodyEnd])
-            let fullRecord = Data(receiveBuffer[headerStart..<bodyEnd])
-
-            receiveBuffer.removeSubrange(headerStart..<bodyEnd)
-            recordsProcessed += 1
-
-            // Compact buffer to reclaim backing storage
-            if receiveBuffer.isEmpty {
-                receiveBuffer = Data()
-            }
-
-            if contentType == 0x17 { // Application Data
-                seqLock.lock()
-                let seqNum = serverSeqNum
-                serverSeqNum += 1
-                seqLock.unlock()
-
-                do {
-                    let decrypted = try decryptTLSRecord(ciphertext: body, header: header, seqNum: seqNum)
-                    if !decrypted.isEmpty {
-                        batchedData.append(decrypted)
-                    }
-                } catch {
-                    failedRecordData = fullRecord
-                    if !receiveBuffer.isEmpty {
-                        failedRecordData!.append(receiveBuffer)
-                        receiveBuffer.removeAll()
+        var consumed = 0
+        var failedRecordOffset: Int? = nil
+        var seqNum = serverSeqNum
+
+        receiveBuffer.withUnsafeBytes { buffer in
+            guard let base = buffer.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return }
+
+            while buffer.count - consumed >= 5 {
+                var contentType: UInt8 = 0
+                var recordLen: UInt16 = 0
+                guard parse_tls_header(base + consumed, buffer.count - consumed,
+                                       &contentType, &recordLen) != 0 else { break }
+
+                let recordStart = consumed
+                let totalLen = 5 + Int(recordLen)
+                guard buffer.count - recordStart >= totalLen else { break }
+                consumed += totalLen
+                recordsProcessed += 1
+
+                if contentType == 0x17 { // Application Data
+                    let header = UnsafeRawBufferPointer(rebasing: buffer[recordStart..<recordStart + 5])
+                    let body = UnsafeRawBufferPointer(rebasing: buffer[recordStart + 5..<consumed])
+                    do {
+                        try decryptTLSRecord(ciphertext: body, header: header, seqNum: seqNum, into: &batchedData)
+                        seqNum += 1
+                    } catch {
+                        failedRecordOffset = recordStart
+                        hasError = error
+                        break
                     }
-                    hasError = error
+                } else if contentType == 0x15 { // Alert
+                    hasError = RealityError.connectionFailed("TLS Alert received")
                     break
                 }
-            } else if contentType == 0x15 { // Alert
-                hasError = RealityError.connectionFailed("TLS Alert received")
-                break
+                // Other content types (ChangeCipherSpec, etc.) are skipped
             }
-            // Other content types (ChangeCipherSpec, etc.) are skipped
+        }
+
+        serverSeqNum = seqNum
+
+        // Compact once per batch; a drained buffer releases its storage
+        var failedRecordData: Data? = nil
+        if let failedRecordOffset {
+            failedRecordData = receiveBuffer.subdata(in: receiveBuffer.startIndex + failedRecordOffset..<receiveBuffer.endIndex)
+            receiveBuffer = Data()
+        } else if consumed == receiveBuffer.count {
+            receiveBuffer = Data()
+        } else if consumed > 0 {
+            receiveBuffer.removeSubrange(receiveBuffer.startIndex..<receiveBuffer.startIndex + consumed)
         }
 
         if let error = hasError {
@@ -379,32 +357,29 @@ class TLSRecordConnection {
 
     // MARK: - TLS Record Crypto
 
-    /// Decrypts a TLS 1.3 Application Data record using AES-GCM.
+    /// Decrypts a TLS 1.3 Application Data record with the negotiated AEAD and appends
+    /// its content to `output`.
     ///
     /// - Parameters:
-    ///   - ciphertext: The encrypted record body (ciphertext + 16-byte GCM tag).
+    ///   - ciphertext: The encrypted record body (ciphertext + 16-byte tag).
     ///   - header: The 5-byte TLS record header used as additional authenticated data.
     ///   - seqNum: The server sequence number for nonce construction.
-    /// - Returns: The decrypted inner plaintext (content type byte stripped).
-    private func decryptTLSRecord(ciphertext: Data, header: Data, seqNum: UInt64) throws -> Data {
+    ///   - output: Receives the inner plaintext (content type byte and padding
+    ///     stripped); post-handshake messages append nothing.
+    private func decryptTLSRecord(ciphertext: UnsafeRawBufferPointer, header: UnsafeRawBufferPointer,
+                                  seqNum: UInt64, into output: inout Data) throws {
         guard ciphertext.count >= 16 else {
             throw RealityError.handshakeFailed("Ciphertext too short")
         }
 
-        // Build nonce: XOR IV with sequence number
-        var nonce = serverIV
-        nonce.withUnsafeMutableBytes { ptr in
-            xor_nonce_with_seq(ptr.baseAddress!.assumingMemoryBound(to: UInt8.self), seqNum)
-        }
-        let nonceObj = try AES.GCM.Nonce(data: nonce)
-
-        // Split ciphertext and GCM tag
+        // Split ciphertext and tag
         let tagOffset = ciphertext.count - 16
-        let ct = ciphertext.prefix(tagOffset)
-        let tag = ciphertext.suffix(16)
-
-        let sealedBox = try AES.GCM.SealedBox(nonce: nonceObj, ciphertext: ct, tag: tag)
-        let decrypted = try AES.GCM.open(sealedBox, using: serverSymmetricKey, authenticating: header)
+        let decrypted = try serverCipher.open(
+            ciphertext: UnsafeRawBufferPointer(rebasing: ciphertext[..<tagOffset]),
+            tag: UnsafeRawBufferPointer(rebasing: ciphertext[tagOffset...]),
+            seqNum: seqNum,
+            authenticating: header
+        )
 
         guard !decrypted.isEmpty else {
             throw RealityError.handshakeFailed("Empty decrypted data")
@@ -426,66 +401,74 @@ class TLSRecordConnection {
 
         // Post-handshake messages (0x16) are skipped
         if innerContentType == 0x16 {
-            return Data()
-        }
-
-        return decrypted.prefix(Int(contentLen))
-    }
-
-    /// Encrypts plaintext and builds a complete TLS 1.3 Application Data record.
-    ///
-    /// - Parameters:
-    ///   - plaintext: The data to encrypt.
-    ///   - seqNum: The client sequence number for nonce construction.
-    /// - Returns: A complete TLS record (header + encrypted payload + GCM tag).
-    private func encryptAndBuildTLSRecord(plaintext: Data, seqNum: UInt64) throws -> Data {
-        let innerLen = plaintext.count + 1 // +1 for inner content type
-        let encryptedLen = innerLen + 16    // +16 for GCM tag
-
-        // Build nonce: XOR IV with sequence number
-        var nonce = clientIV
-        nonce.withUnsafeMutableBytes { ptr in
-            xor_nonce_with_seq(ptr.baseAddress!.assumingMemoryBound(to: UInt8.self), seqNum)
+            return
         }
 
-        // Build TLS 1.3 inner plaintext: payload + content type byte
-        var innerPlaintext = Data(count: innerLen)
-        innerPlaintext.withUnsafeMutableBytes { buffer in
-            plaintext.copyBytes(to: buffer)
-            buffer[plaintext.count] = 0x17 // Application Data content type
+        decrypted.withUnsafeBytes { ptr in
+            output.append(contentsOf: UnsafeRawBufferPointer(rebasing: ptr[..<Int(contentLen)]))
         }
+    }
 
-        // AAD = TLS record header
-        let aad = Data([0x17, 0x03, 0x03, UInt8(encryptedLen >> 8), UInt8(encryptedLen & 0xFF)])
+    /// Maximum TLS 1.3 record content length (RFC 8446 §5.1).
+    private static let maxRecordPlaintext = 16384
 
-        let nonceObj = try AES.GCM.Nonce(data: nonce)
-        let sealedBox = try AES.GCM.seal(innerPlaintext, using: clientSymmetricKey, nonce: nonceObj, authenticating: aad)
+    /// Per-record overhead: 5-byte header, inner content type, 16-byte AEAD tag.
+    private static let recordOverhead = 5 + 1 + 16
 
-        guard let combined = sealedBox.combined else {
-            throw RealityError.handshakeFailed("Failed to get combined sealed box")
-        }
+    /// Splits plaintext into maximal TLS 1.3 Application Data records and seals
+    /// them into one contiguous buffer for a single socket write.
+    ///
+    /// Each record is laid out as header, ciphertext and tag. The inner
+    /// plaintext is staged where its ciphertext will go and the header doubles
+    /// as the AAD, so the only per-record allocation is CryptoKit's sealed box.
+    /// Sequence numbers for the whole batch are reserved with one atomic add.
+    ///
+    /// - Parameter plaintext: The data to encrypt. Empty data yields one empty record.
+    /// - Returns: The concatenated records.
+    private func sealRecords(plaintext: Data) throws -> Data {
+        let recordCount = max(1, (plaintext.count + Self.maxRecordPlaintext - 1) / Self.maxRecordPlaintext)
+
+        let firstSeqNum = tls_seq_reserve(clientSeqNum, UInt64(recordCount))
+
+        var output = Data(count: plaintext.count + recordCount * Self.recordOverhead)
+        try output.withUnsafeMutableBytes { out in
+            try plaintext.withUnsafeBytes { input in
+                var inOffset = 0
+                var outOffset = 0
+                for i in 0..<recordCount {
+                    let chunkLen = min(Self.maxRecordPlaintext, input.count - inOffset)
+                    let innerLen = chunkLen + 1 // +1 for inner content type
+                    let encryptedLen = innerLen + 16 // +16 for AEAD tag
+                    let body = outOffset + 5
+
+                    // TLS record header, also the AAD
+                    out[outOffset] = 0x17 // Application Data
+                    out[outOffset + 1] = 0x03
+                    out[outOffset + 2] = 0x03 // TLS 1.2 version (per spec)
+                    out[outOffset + 3] = UInt8(encryptedLen >> 8)
+                    out[outOffset + 4] = UInt8(encryptedLen & 0xFF)
+
+                    // Stage the inner plaintext (payload + content type byte)
+                    if chunkLen > 0 {
+                        UnsafeMutableRawBufferPointer(rebasing: out[body..<body + chunkLen])
+                            .copyMemory(from: UnsafeRawBufferPointer(rebasing: input[inOffset..<inOffset + chunkLen]))
+                    }
+                    out[body + chunkLen] = 0x17 // Application Data content type
+
+                    try clientCipher.seal(
+                        UnsafeRawBufferPointer(rebasing: out[body..<body + innerLen]),
+                        seqNum: firstSeqNum + UInt64(i),
+                        authenticating: UnsafeRawBufferPointer(rebasing: out[outOffset..<body])
+                    ) { ciphertext, tag in
+                        _ = ciphertext.copyBytes(to: UnsafeMutableRawBufferPointer(rebasing: out[body..<body + innerLen]))
+                        _ = tag.copyBytes(to: UnsafeMutableRawBufferPointer(rebasing: out[body + innerLen..<body + encryptedLen]))
+                    }
 
-        // Build complete TLS record: 5-byte header + ciphertext + tag
-        var record = Data(count: 5 + encryptedLen)
-        record.withUnsafeMutableBytes { buffer in
-            let ptr = buffer.bindMemory(to: UInt8.self)
-
-            // TLS record header
-            buffer[0] = 0x17 // Application Data
-            buffer[1] = 0x03
-            buffer[2] = 0x03 // TLS 1.2 version (per spec)
-            buffer[3] = UInt8(encryptedLen >> 8)
-            buffer[4] = UInt8(encryptedLen & 0xFF)
-
-            // Copy ciphertext + tag (skip 12-byte nonce prefix from combined)
-            combined.withUnsafeBytes { srcBuffer in
-                let src = srcBuffer.bindMemory(to: UInt8.self)
-                for i in 12..<combined.count {
-                    ptr[5 + i - 12] = src[i]
+                    inOffset += chunkLen
+                    outOffset = body + encryptedLen
                 }
             }
         }
-
-        return record
+        return output
     }
 }
@@ -8,22 +8,85 @@
 import Foundation
 import CryptoKit
 
-/// TLS 1.3 record layer cryptographic operations
-struct TLSRecordCrypto {
-    /// Build nonce for TLS 1.3 record encryption/decryption
-    /// The sequence number is XOR'd with the last 8 bytes of the 12-byte IV
-    static func buildNonce(iv: Data, seqNum: UInt64) -> Data {
-        var nonce = iv
-        for i in 0..<8 {
-            nonce[nonce.count - 8 + i] ^= UInt8((seqNum >> (56 - i * 8)) & 0xFF)
+/// Cipher state for one direction of a TLS 1.3 connection.
+///
+/// Built once per traffic key: holds the key, the AEAD of the negotiated
+/// suite and the 12-byte static IV as two fixed-size words, so a per-record
+/// nonce (RFC 8446 §5.3) is one 64-bit XOR of the sequence number into the
+/// IV's last 8 bytes. Both AEADs use a 16-byte tag.
+struct TLSCipherContext {
+    /// Record protection algorithm of a TLS 1.3 cipher suite.
+    enum AEAD {
+        case aesGCM
+        case chaChaPoly
+
+        init(cipherSuite: UInt16) {
+            self = cipherSuite == TLSCipherSuite.TLS_CHACHA20_POLY1305_SHA256 ? .chaChaPoly : .aesGCM
+        }
+    }
+
+    let key: SymmetricKey
+    let aead: AEAD
+
+    // IV bytes 0..<4 and 4..<12, in memory order
+    private let ivHead: UInt32
+    private let ivTail: UInt64
+
+    init(key: Data, iv: Data, cipherSuite: UInt16) {
+        precondition(iv.count == 12, "TLS 1.3 IV must be 12 bytes")
+        self.key = SymmetricKey(data: key)
+        self.aead = AEAD(cipherSuite: cipherSuite)
+        self.ivHead = iv.withUnsafeBytes { $0.loadUnaligned(as: UInt32.self) }
+        self.ivTail = iv.withUnsafeBytes { $0.loadUnaligned(fromByteOffset: 4, as: UInt64.self) }
+    }
+
+    /// Encrypts record `seqNum`, calling `body` with the ciphertext and tag.
+    func seal<Plaintext: DataProtocol, AAD: DataProtocol, Result>(
+        _ plaintext: Plaintext, seqNum: UInt64, authenticating aad: AAD,
+        _ body: (_ ciphertext: Data, _ tag: Data) throws -> Result
+    ) throws -> Result {
+        try withNonce(for: seqNum) { nonce in
+            switch aead {
+            case .aesGCM:
+                let box = try AES.GCM.seal(plaintext, using: key, nonce: AES.GCM.Nonce(data: nonce), authenticating: aad)
+                return try body(box.ciphertext, box.tag)
+            case .chaChaPoly:
+                let box = try ChaChaPoly.seal(plaintext, using: key, nonce: ChaChaPoly.Nonce(data: nonce), authenticating: aad)
+                return try body(box.ciphertext, box.tag)
+            }
         }
-        return nonce
     }
 
-    /// Encrypt a TLS 1.3 handshake record using AES-GCM
-    static func encryptHandshakeRecord(plaintext: Data, key: Data, iv: Data, seqNum: UInt64) throws -> Data {
-        let nonce = buildNonce(iv: iv, seqNum: seqNum)
+    /// Authenticates and decrypts record `seqNum`.
+    func open<Ciphertext: DataProtocol, Tag: DataProtocol, AAD: DataProtocol>(
+        ciphertext: Ciphertext, tag: Tag, seqNum: UInt64, authenticating aad: AAD
+    ) throws -> Data {
+        try withNonce(for: seqNum) { nonce in
+            switch aead {
+            case .aesGCM:
+                let box = try AES.GCM.SealedBox(nonce: AES.GCM.Nonce(data: nonce), ciphertext: ciphertext, tag: tag)
+                return try AES.GCM.open(box, using: key, authenticating: aad)
+            case .chaChaPoly:
+                let box = try ChaChaPoly.SealedBox(nonce: ChaChaPoly.Nonce(data: nonce), ciphertext: ciphertext, tag: tag)
+                return try ChaChaPoly.open(box, using: key, authenticating: aad)
+            }
+        }
+    }
+
+    /// Calls `body` with the nonce bytes for record `seqNum`.
+    private func withNonce<Result>(for seqNum: UInt64, _ body: (UnsafeRawBufferPointer) throws -> Result) rethrows -> Result {
+        try withUnsafeTemporaryAllocation(byteCount: 12, alignment: 4) { buffer in
+            buffer.storeBytes(of: ivHead, as: UInt32.self)
+            buffer.storeBytes(of: ivTail ^ seqNum.bigEndian, toByteOffset: 4, as: UInt64.self)
+            return try body(UnsafeRawBufferPointer(buffer))
+        }
+    }
+}
 
+/// TLS 1.3 record layer cryptographic operations
+struct TLSRecordCrypto {
+    /// Encrypt a TLS 1.3 handshake record with the negotiated AEAD
+    static func encryptHandshakeRecord(plaintext: Data, cipher: TLSCipherContext, seqNum: UInt64) throws -> Data {
         // The plaintext includes the real content type at the end
         var innerPlaintext = plaintext
         innerPlaintext.append(0x16) // Handshake content type
@@ -38,22 +101,15 @@ struct TLSRecordCrypto {
         aad.append(UInt8(len & 0xFF))
 
         // Encrypt
-        let symmetricKey = SymmetricKey(data: key)
-        let nonceObj = try AES.GCM.Nonce(data: nonce)
-        let sealedBox = try AES.GCM.seal(innerPlaintext, using: symmetricKey, nonce: nonceObj, authenticating: aad)
-
-        var result = Data(sealedBox.ciphertext)
-        result.append(contentsOf: sealedBox.tag)
-        return result
+        return try cipher.seal(innerPlaintext, seqNum: seqNum, authenticating: aad) { ciphertext, tag in
+            var result = ciphertext
+            result.append(tag)
+            return result
+        }
     }
 
-    /// Decrypt a TLS 1.3 record using AES-GCM
-    static func decryptRecord(ciphertext: Data, key: Data, iv: Data, seqNum: UInt64, recordHeader: Data) throws -> Data {
-        let nonce = buildNonce(iv: iv, seqNum: seqNum)
-
-        let symmetricKey = SymmetricKey(data: key)
-        let nonceObj = try AES.GCM.Nonce(data: nonce)
-
+    /// Decrypt a TLS 1.3 record with the negotiated AEAD
+    static func decryptRecord(ciphertext: Data, cipher: TLSCipherContext, seqNum: UInt64, recordHeader: Data) throws -> Data {
         guard ciphertext.count >= 16 else {
             throw TLSRecordError.ciphertextTooShort
         }
@@ -61,8 +117,7 @@ struct TLSRecordCrypto {
         let ct = ciphertext.prefix(ciphertext.count - 16)
         let tag = ciphertext.suffix(16)
 
-        let sealedBox = try AES.GCM.SealedBox(nonce: nonceObj, ciphertext: ct, tag: tag)
-        let decrypted = try AES.GCM.open(sealedBox, using: symmetricKey, authenticating: recordHeader)
+        let decrypted = try cipher.open(ciphertext: ct, tag: tag, seqNum: seqNum, authenticating: recordHeader)
 
         // TLS 1.3 inner plaintext: content + contentType + zeros (padding)
         // Find the last non-zero byte (the content type) and remove it along with padding
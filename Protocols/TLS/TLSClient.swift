@@ -401,8 +401,7 @@ class TLSClient {
                     let seqNum = serverHandshakeSeqNum
                     let decrypted = try TLSRecordCrypto.decryptRecord(
                         ciphertext: ciphertext,
-                        key: keys.serverKey,
-                        iv: keys.serverIV,
+                        cipher: keys.serverCipher,
                         seqNum: seqNum,
                         recordHeader: recordHeader
                     )
@@ -710,7 +709,8 @@ class TLSClient {
                 clientKey: appKeys.clientKey,
                 clientIV: appKeys.clientIV,
                 serverKey: appKeys.serverKey,
-                serverIV: appKeys.serverIV
+                serverIV: appKeys.serverIV,
+                cipherSuite: appKeys.cipherSuite
             )
             tlsConnection.connection = self.connection
             self.connection = nil
@@ -747,8 +747,7 @@ class TLSClient {
         do {
             let encrypted = try TLSRecordCrypto.encryptHandshakeRecord(
                 plaintext: finishedMsg,
-                key: keys.clientKey,
-                iv: keys.clientIV,
+                cipher: keys.clientCipher,
                 seqNum: 0
             )
 
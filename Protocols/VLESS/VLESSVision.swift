@@ -20,8 +20,6 @@ enum VisionCommand: UInt8 {
 /// TLS detection constants
 private let tlsClientHandshakeStart: [UInt8] = [0x16, 0x03]
 private let tlsServerHandshakeStart: [UInt8] = [0x16, 0x03, 0x03]
-private let tlsApplicationDataStart: [UInt8] = [0x17, 0x03, 0x03]
-private let tls13SupportedVersions: [UInt8] = [0x00, 0x2b, 0x00, 0x02, 0x03, 0x04]
 private let tlsHandshakeTypeClientHello: UInt8 = 0x01
 private let tlsHandshakeTypeServerHello: UInt8 = 0x02
 
@@ -47,10 +45,12 @@ class VisionTrafficState {
     var isTLS: Bool = false
     var cipher: UInt16 = 0
     var remainingServerHello: Int32 = -1
+    var tls13VersionMatched: UInt8 = 0  // supported_versions bytes matched so far
 
     // Writer state (for outgoing data)
     var writerIsPadding: Bool = true
     var writerDirectCopy: Bool = false
+    var writerRecords = vision_record_tracker()  // TLS framing of outgoing data
 
     // Reader state (for incoming data)
     var readerWithinPaddingBuffers: Bool = true
@@ -66,10 +66,21 @@ class VisionTrafficState {
     // Vision padding seed: [contentThreshold, longPaddingMax, longPaddingBase, shortPaddingMax]
     let testseed: [UInt32]
 
+    // Source of padding bytes, seeded once per connection
+    let paddingKeystream = UnsafeMutablePointer<vision_keystream>.allocate(capacity: 1)
+
     init(userUUID: Data, testseed: [UInt32] = [900, 500, 900, 256]) {
         self.userUUID = userUUID
         self.writeOnceUserUUID = userUUID
         self.testseed = testseed.count >= 4 ? testseed : [900, 500, 900, 256]
+
+        var seed = [UInt8](repeating: 0, count: 32)
+        _ = SecRandomCopyBytes(kSecRandomDefault, seed.count, &seed)
+        vision_keystream_init(paddingKeystream, seed)
+    }
+
+    deinit {
+        paddingKeystream.deallocate()
     }
 }
 
@@ -83,27 +94,18 @@ private let reshapeThreshold: Int = 8192 - 21  // 8171
 
 /// Split data that is too large for a single Vision-padded frame.
 /// Tries to split at the last TLS application data boundary; falls back to midpoint.
-/// Matches Xray-core's `ReshapeMultiBuffer`.
-private func reshapeData(_ data: Data) -> [Data] {
+/// Matches Xray-core's `ReshapeMultiBuffer`. Returns index ranges into `data`
+/// so callers can pad slices without copying.
+private func reshapeData(_ data: Data) -> [Range<Data.Index>] {
     guard data.count >= reshapeThreshold else {
-        return [data]
+        return [data.startIndex..<data.endIndex]
     }
 
-    // Find last occurrence of TLS application data header (0x17 0x03 0x03)
-    var splitIndex = data.count / 2
-    let bytes = data.withUnsafeBytes { Array(UnsafeBufferPointer(start: $0.baseAddress!.assumingMemoryBound(to: UInt8.self), count: data.count)) }
-    for i in stride(from: bytes.count - 3, through: 0, by: -1) {
-        if bytes[i] == 0x17 && bytes[i + 1] == 0x03 && bytes[i + 2] == 0x03 {
-            if i >= 21 && i <= reshapeThreshold {
-                splitIndex = i
-                break
-            }
-        }
+    let splitIndex = data.withUnsafeBytes { ptr in
+        vision_reshape_split(ptr.baseAddress!.assumingMemoryBound(to: UInt8.self), ptr.count, reshapeThreshold)
     }
-
-    let first = data.prefix(splitIndex)
-    let second = data.suffix(from: data.index(data.startIndex, offsetBy: splitIndex))
-    return [Data(first), Data(second)]
+    let split = data.startIndex + splitIndex
+    return [data.startIndex..<split, split..<data.endIndex]
 }
 
 // MARK: - Padding Functions
@@ -111,6 +113,13 @@ private func reshapeData(_ data: Data) -> [Data] {
 /// Add Vision padding to data
 /// Format: [UUID (16 bytes, first packet only)] [command (1)] [contentLen (2)] [paddingLen (2)] [content] [padding]
 func visionPadding(data: Data?, command: VisionCommand, state: VisionTrafficState, longPadding: Bool) -> Data {
+    var result = Data()
+    appendVisionPadding(to: &result, data: data, command: command, state: state, longPadding: longPadding)
+    return result
+}
+
+/// Append one Vision-padded frame of `data` to `output`, written in place
+func appendVisionPadding(to output: inout Data, data: Data?, command: VisionCommand, state: VisionTrafficState, longPadding: Bool) {
     let contentLen = Int32(data?.count ?? 0)
     var paddingLen: Int32 = 0
 
@@ -131,105 +140,88 @@ func visionPadding(data: Data?, command: VisionCommand, state: VisionTrafficStat
         paddingLen = 0
     }
 
-    var result = Data()
-
-    // Add UUID on first packet
-    if let uuid = state.writeOnceUserUUID {
-        result.append(uuid)
-        state.writeOnceUserUUID = nil
-    }
+    // Reserve the whole frame once, then write it in place
+    let uuid = state.writeOnceUserUUID
+    state.writeOnceUserUUID = nil
+    let headerLen = (uuid?.count ?? 0) + 5
+    let frameStart = output.count
+    output.count += headerLen + Int(contentLen) + Int(paddingLen)
+
+    output.withUnsafeMutableBytes { ptr in
+        let out = ptr.baseAddress!.assumingMemoryBound(to: UInt8.self) + frameStart
+        var offset = 0
+
+        // Add UUID on first packet
+        if let uuid {
+            uuid.copyBytes(to: out, count: uuid.count)
+            offset = uuid.count
+        }
 
-    // Add command header: [command (1)] [contentLen (2)] [paddingLen (2)]
-    result.append(command.rawValue)
-    result.append(UInt8(contentLen >> 8))
-    result.append(UInt8(contentLen & 0xFF))
-    result.append(UInt8(paddingLen >> 8))
-    result.append(UInt8(paddingLen & 0xFF))
+        // Add command header: [command (1)] [contentLen (2)] [paddingLen (2)]
+        out[offset] = command.rawValue
+        out[offset + 1] = UInt8(contentLen >> 8)
+        out[offset + 2] = UInt8(contentLen & 0xFF)
+        out[offset + 3] = UInt8(paddingLen >> 8)
+        out[offset + 4] = UInt8(paddingLen & 0xFF)
+        offset += 5
 
-    // Add content
-    if let data = data {
-        result.append(data)
-    }
+        // Add content
+        if let data, !data.isEmpty {
+            data.copyBytes(to: out + offset, count: data.count)
+            offset += data.count
+        }
 
-    // Add random padding
-    if paddingLen > 0 {
-        var padding = Data(count: Int(paddingLen))
-        padding.withUnsafeMutableBytes { ptr in
-            _ = SecRandomCopyBytes(kSecRandomDefault, Int(paddingLen), ptr.baseAddress!)
+        // Add random padding from the connection's keystream
+        if paddingLen > 0 {
+            vision_keystream_fill(state.paddingKeystream, out + offset, Int(paddingLen))
         }
-        result.append(padding)
     }
-
-    return result
 }
 
 /// Remove Vision padding from data and extract content
-/// Returns the extracted content data
+/// Returns the extracted content data. The frame state machine (vision_unpad
+/// in CVLESS.c) walks `data` once with an offset and writes content straight
+/// into the result.
 func visionUnpadding(data: inout Data, state: VisionTrafficState) -> Data {
+    var offset = 0
+
     // Initial state check - look for UUID prefix
     if state.remainingCommand == -1 && state.remainingContent == -1 && state.remainingPadding == -1 {
         if data.count >= 21 && data.prefix(16) == state.userUUID {
-            data = Data(data.dropFirst(16))
+            offset = 16
             state.remainingCommand = 5
         } else {
             // No Vision header, return data as-is
             return data
         }
     }
-
-    var result = Data()
-
-    while !data.isEmpty {
-        if state.remainingCommand > 0 {
-            // Reading command header
-            let byte = data.removeFirst()
-            switch state.remainingCommand {
-            case 5:
-                state.currentCommand = Int(byte)
-            case 4:
-                state.remainingContent = Int32(byte) << 8
-            case 3:
-                state.remainingContent |= Int32(byte)
-            case 2:
-                state.remainingPadding = Int32(byte) << 8
-            case 1:
-                state.remainingPadding |= Int32(byte)
-            default:
-                break
-            }
-            state.remainingCommand -= 1
-        } else if state.remainingContent > 0 {
-            // Reading content
-            let toRead = min(Int(state.remainingContent), data.count)
-            result.append(data.prefix(toRead))
-            data = Data(data.dropFirst(toRead))
-            state.remainingContent -= Int32(toRead)
-        } else if state.remainingPadding > 0 {
-            // Skipping padding
-            let toSkip = min(Int(state.remainingPadding), data.count)
-            data = Data(data.dropFirst(toSkip))
-            state.remainingPadding -= Int32(toSkip)
-        }
-
-        // Check if current block is done
-        if state.remainingCommand <= 0 && state.remainingContent <= 0 && state.remainingPadding <= 0 {
-            if state.currentCommand == 0 {
-                // Continue - expect another block
-                state.remainingCommand = 5
-            } else {
-                // End or Direct - reset to initial state
-                state.remainingCommand = -1
-                state.remainingContent = -1
-                state.remainingPadding = -1
-                if !data.isEmpty {
-                    // Remaining data after padding ends
-                    result.append(data)
-                    data = Data()
-                }
-                break
-            }
+    guard data.count > offset else { return Data() }
+
+    var unpadState = vision_unpad_state(
+        remaining_command: state.remainingCommand,
+        remaining_content: state.remainingContent,
+        remaining_padding: state.remainingPadding,
+        current_command: Int32(truncatingIfNeeded: state.currentCommand)
+    )
+
+    var result = Data(count: data.count - offset)
+    let written = result.withUnsafeMutableBytes { out in
+        data.withUnsafeBytes { input in
+            vision_unpad(
+                &unpadState,
+                input.baseAddress!.assumingMemoryBound(to: UInt8.self) + offset,
+                input.count - offset,
+                out.baseAddress?.assumingMemoryBound(to: UInt8.self)
+            )
         }
     }
+    result.count = written
+    data = Data()
+
+    state.remainingCommand = unpadState.remaining_command
+    state.remainingContent = unpadState.remaining_content
+    state.remainingPadding = unpadState.remaining_padding
+    state.currentCommand = Int(unpadState.current_command)
 
     return result
 }
@@ -279,8 +271,12 @@ func visionFilterTLS(data: Data, state: VisionTrafficState) {
         let end = min(Int(state.remainingServerHello), data.count)
         state.remainingServerHello -= Int32(data.count)
 
-        // Search for TLS 1.3 supported versions extension
-        if let _ = data.prefix(end).range(of: Data(tls13SupportedVersions)) {
+        // Search for TLS 1.3 supported versions extension, resuming a match
+        // split across reads
+        let found = data.withUnsafeBytes { ptr in
+            vision_find_tls13_version(&state.tls13VersionMatched, ptr.baseAddress!.assumingMemoryBound(to: UInt8.self), end) != 0
+        }
+        if found {
             // Found TLS 1.3
             if tls13CipherSuites.contains(state.cipher) {
                 state.enableXtls = true
@@ -310,45 +306,13 @@ func visionDetectClientHello(data: Data, state: VisionTrafficState) {
     }
 }
 
-/// Check if data is a complete TLS application data record
-func isCompleteTLSRecord(data: Data) -> Bool {
-    let totalLen = data.count
-
-    // Quick check - if data doesn't start with TLS app data header, return false
-    guard totalLen >= 5 else { return false }
-
-    let startIdx = data.startIndex
-    guard data[startIdx] == 0x17 &&
-          data[data.index(startIdx, offsetBy: 1)] == 0x03 &&
-          data[data.index(startIdx, offsetBy: 2)] == 0x03 else { return false }
-
-    var offset = 0
-
-    while offset < totalLen {
-        // Need at least 5 bytes for TLS record header
-        guard offset + 5 <= totalLen else { return false }
-
-        let idx0 = data.index(startIdx, offsetBy: offset)
-        let idx1 = data.index(startIdx, offsetBy: offset + 1)
-        let idx2 = data.index(startIdx, offsetBy: offset + 2)
-        let idx3 = data.index(startIdx, offsetBy: offset + 3)
-        let idx4 = data.index(startIdx, offsetBy: offset + 4)
-
-        // Check for application data header: 0x17 0x03 0x03
-        guard data[idx0] == 0x17,
-              data[idx1] == 0x03,
-              data[idx2] == 0x03 else { return false }
-
-        // Get record length
-        let recordLen = Int(data[idx3]) << 8 | Int(data[idx4])
-        offset += 5
-
-        // Check if we have the full record
-        guard offset + recordLen <= totalLen else { return false }
-        offset += recordLen
+/// Check if data is a complete TLS application data record, advancing the
+/// outgoing record tracker so each chunk only costs its own record headers
+func isCompleteTLSRecord(data: Data, state: VisionTrafficState) -> Bool {
+    data.withUnsafeBytes { ptr in
+        guard let base = ptr.baseAddress else { return false }
+        return vision_record_tracker_feed(&state.writerRecords, base.assumingMemoryBound(to: UInt8.self), ptr.count) != 0
     }
-
-    return offset == totalLen
 }
 
 // MARK: - Vision Connection Wrapper
@@ -423,21 +387,17 @@ class VLESSVisionConnection: VLESSConnection {
         }
 
         let longPadding = trafficState.isTLS
-        let isComplete = isCompleteTLSRecord(data: data)
+        let isComplete = isCompleteTLSRecord(data: data, state: trafficState)
 
         // Reshape oversized buffers to ensure room for the 21-byte Vision padding header
         let chunks = reshapeData(data)
+        var result = Data()
 
         // Check if this is TLS application data and we should end padding
-        let startIdx = data.startIndex
-        if trafficState.isTLS && data.count >= 6 &&
-           data[startIdx] == tlsApplicationDataStart[0] &&
-           data[data.index(startIdx, offsetBy: 1)] == tlsApplicationDataStart[1] &&
-           data[data.index(startIdx, offsetBy: 2)] == tlsApplicationDataStart[2] &&
-           isComplete {
+        // (a complete record run always starts with an application data header)
+        if trafficState.isTLS && data.count >= 6 && isComplete {
 
             // End padding mode — pad each chunk, last one gets the terminal command
-            var result = Data()
             for (i, chunk) in chunks.enumerated() {
                 if i == chunks.count - 1 {
                     var command: VisionCommand = .paddingEnd
@@ -446,9 +406,9 @@ class VLESSVisionConnection: VLESSConnection {
                         trafficState.writerDirectCopy = true
                     }
                     trafficState.writerIsPadding = false
-                    result.append(visionPadding(data: chunk, command: command, state: trafficState, longPadding: false))
+                    appendVisionPadding(to: &result, data: data[chunk], command: command, state: trafficState, longPadding: false)
                 } else {
-                    result.append(visionPadding(data: chunk, command: .paddingContinue, state: trafficState, longPadding: true))
+                    appendVisionPadding(to: &result, data: data[chunk], command: .paddingContinue, state: trafficState, longPadding: true)
                 }
             }
             return result
@@ -457,18 +417,16 @@ class VLESSVisionConnection: VLESSConnection {
         // For compatibility with earlier vision receiver, finish padding 1 packet early (matches Xray-core <= 1)
         if !trafficState.isTLS12orAbove && trafficState.numberOfPacketsToFilter <= 1 {
             trafficState.writerIsPadding = false
-            var result = Data()
             for (i, chunk) in chunks.enumerated() {
                 let cmd: VisionCommand = (i == chunks.count - 1) ? .paddingEnd : .paddingContinue
-                result.append(visionPadding(data: chunk, command: cmd, state: trafficState, longPadding: longPadding))
+                appendVisionPadding(to: &result, data: data[chunk], command: cmd, state: trafficState, longPadding: longPadding)
             }
             return result
         }
 
         // Continue with padding
-        var result = Data()
         for chunk in chunks {
-            result.append(visionPadding(data: chunk, command: .paddingContinue, state: trafficState, longPadding: longPadding))
+            appendVisionPadding(to: &result, data: data[chunk], command: .paddingContinue, state: trafficState, longPadding: longPadding)
         }
         return result
     }
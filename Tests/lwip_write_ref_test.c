@@ -0,0 +1,231 @@
+//
+//  lwip_write_ref_test.c
+//  Tests
+//
+//  Checks that lwip_bridge_tcp_write_ref() memory outlives batched output.
+//  Queued output refers to written data through iovecs into PBUF_ROM pbufs;
+//  holding the pbufs does not hold the memory, so the release callback must
+//  not run while the queue may still point at it. One connection is driven
+//  through a write whose segment is held in the output queue (non-zero flush
+//  latency), then one input batch acknowledges it, writes more from the sent
+//  callback and resets the connection. The release callback poisons its
+//  buffer; every emitted payload byte must still hold the written pattern.
+//
+//  Usage: lwip_write_ref_test
+//
+
+#include "lwip_bridge.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_ACK 0x10
+
+#define POISON  0xDD
+
+static const uint8_t CLIENT_IP[4] = { 10, 0, 0, 1 };
+static const uint8_t SERVER_IP[4] = { 10, 0, 0, 2 };
+static const uint16_t CLIENT_PORT = 40000;
+static const uint16_t SERVER_PORT = 443;
+static const uint32_t CLIENT_ISN = 1000;
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) do {                       \
+    if (!(cond)) {                                  \
+        printf("FAIL line %d: ", __LINE__);         \
+        printf(__VA_ARGS__);                        \
+        printf("\n");                               \
+        s_failures++;                               \
+    }                                               \
+} while (0)
+
+/* ========================================================================
+ *  Written buffers
+ * ======================================================================== */
+
+struct write_buf {
+    uint8_t  data[512];
+    uint16_t len;
+    uint8_t  pattern;
+    int      released;
+};
+
+static struct write_buf s_first  = { .len = 300, .pattern = 'A' };
+static struct write_buf s_second = { .len = 200, .pattern = 'B' };
+
+static void write_release(void *ctx) {
+    struct write_buf *w = (struct write_buf *)ctx;
+    w->released++;
+    memset(w->data, POISON, sizeof(w->data));
+}
+
+/* ========================================================================
+ *  Packets
+ * ======================================================================== */
+
+static void wr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void wr32(uint8_t *p, uint32_t v) { wr16(p, (uint16_t)(v >> 16)); wr16(p + 2, (uint16_t)v); }
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static uint32_t rd32(const uint8_t *p) { return ((uint32_t)rd16(p) << 16) | rd16(p + 2); }
+
+/* Client-to-server IPv4 TCP segment; checksums are not verified by the stack */
+static int build_tcp4(uint8_t *buf, uint32_t seq, uint32_t ack, uint8_t flags) {
+    memset(buf, 0, 44);
+    int tcp_len = (flags & TCP_SYN) ? 24 : 20;
+    buf[0] = 0x45;
+    wr16(buf + 2, (uint16_t)(20 + tcp_len));
+    buf[8] = 64;
+    buf[9] = 6;
+    memcpy(buf + 12, CLIENT_IP, 4);
+    memcpy(buf + 16, SERVER_IP, 4);
+
+    uint8_t *tcp = buf + 20;
+    wr16(tcp, CLIENT_PORT);
+    wr16(tcp + 2, SERVER_PORT);
+    wr32(tcp + 4, seq);
+    wr32(tcp + 8, ack);
+    tcp[12] = (uint8_t)((tcp_len / 4) << 4);
+    tcp[13] = flags;
+    wr16(tcp + 14, 65535);
+    if (flags & TCP_SYN) {
+        tcp[20] = 2;        /* MSS */
+        tcp[21] = 4;
+        wr16(tcp + 22, 1360);
+    }
+    return 20 + tcp_len;
+}
+
+/* ========================================================================
+ *  Bridge callbacks
+ * ======================================================================== */
+
+static void *s_pcb = NULL;
+static int s_conn;
+static uint32_t s_server_next = 0;
+static int s_emitted_payload = 0;
+static int s_write_from_sent = 0;
+
+/* Checks each emitted segment while the bridge still owns the iovecs */
+static void test_output_batch(const struct iovec *iov, const int *iovcnt,
+                              const int *is_ipv6, int count) {
+    (void)is_ipv6;
+    const struct iovec *seg = iov;
+    for (int i = 0; i < count; i++) {
+        uint8_t pkt[2048];
+        size_t len = 0;
+        for (int j = 0; j < iovcnt[i]; j++, seg++) {
+            if (len + seg->iov_len > sizeof(pkt)) break;
+            memcpy(pkt + len, seg->iov_base, seg->iov_len);
+            len += seg->iov_len;
+        }
+        if (len < 40 || pkt[9] != 6) continue;
+
+        const uint8_t *tcp = pkt + (pkt[0] & 0x0F) * 4;
+        size_t hdr = (size_t)(tcp - pkt) + (size_t)(tcp[12] >> 4) * 4;
+        uint32_t seq = rd32(tcp + 4);
+        uint32_t end = seq + (uint32_t)(len - hdr);
+        if (tcp[13] & TCP_SYN) end++;
+        if ((int32_t)(end - s_server_next) > 0 || (tcp[13] & TCP_SYN)) s_server_next = end;
+
+        for (size_t k = hdr; k < len; k++) {
+            CHECK(pkt[k] == 'A' || pkt[k] == 'B',
+                  "payload byte %zu of segment seq %u is 0x%02x: written memory was released",
+                  k - hdr, seq, pkt[k]);
+            if (pkt[k] != 'A' && pkt[k] != 'B') break;
+        }
+        s_emitted_payload += (int)(len - hdr);
+    }
+}
+
+static void *test_tcp_accept(const void *src_ip, uint16_t src_port,
+                             const void *dst_ip, uint16_t dst_port,
+                             int is_ipv6, void *pcb) {
+    (void)src_ip; (void)src_port; (void)dst_ip; (void)dst_port; (void)is_ipv6;
+    s_pcb = pcb;
+    return &s_conn;
+}
+
+static void test_tcp_recv(void *conn, const void *data, int len) {
+    (void)conn; (void)data; (void)len;
+}
+
+/* Like LWIPTCPConnection draining its overflow buffer on an ACK */
+static void test_tcp_sent(void *conn, uint16_t len) {
+    (void)conn; (void)len;
+    if (!s_write_from_sent || !s_pcb) return;
+    s_write_from_sent = 0;
+    int err = lwip_bridge_tcp_write_ref(s_pcb, s_second.data, s_second.len, write_release, &s_second);
+    CHECK(err == 0, "write_ref from the sent callback failed: %d", err);
+    lwip_bridge_tcp_output(s_pcb);
+}
+
+static void test_tcp_err(void *conn, int err) {
+    (void)conn; (void)err;
+    s_pcb = NULL;
+}
+
+static void test_log(int level, const char *message) {
+    if (level == LWIP_LOG_ERROR) fprintf(stderr, "%s\n", message);
+}
+
+/* ========================================================================
+ *  Main
+ * ======================================================================== */
+
+int main(void) {
+    memset(s_first.data, s_first.pattern, s_first.len);
+    memset(s_second.data, s_second.pattern, s_second.len);
+
+    lwip_bridge_set_output_batch_fn(test_output_batch);
+    lwip_bridge_set_tcp_accept_fn(test_tcp_accept);
+    lwip_bridge_set_tcp_recv_fn(test_tcp_recv);
+    lwip_bridge_set_tcp_sent_fn(test_tcp_sent);
+    lwip_bridge_set_tcp_err_fn(test_tcp_err);
+    lwip_bridge_set_log_fn(test_log);
+    lwip_bridge_init();
+    lwip_bridge_set_output_batching(64, 0);
+
+    /* Handshake */
+    uint8_t pkt[2][64];
+    int len = build_tcp4(pkt[0], CLIENT_ISN, 0, TCP_SYN);
+    lwip_bridge_input(pkt[0], len);
+    len = build_tcp4(pkt[0], CLIENT_ISN + 1, s_server_next, TCP_ACK);
+    lwip_bridge_input(pkt[0], len);
+    CHECK(s_pcb != NULL, "connection was not accepted");
+    if (!s_pcb) goto done;
+
+    /* Hold output across entry points, as a non-zero flush latency does */
+    lwip_bridge_set_output_batching(64, 60000);
+    int err = lwip_bridge_tcp_write_ref(s_pcb, s_first.data, s_first.len, write_release, &s_first);
+    CHECK(err == 0, "write_ref failed: %d", err);
+    lwip_bridge_tcp_output(s_pcb);
+    CHECK(s_emitted_payload == 0, "output was not held");
+    uint32_t acked = s_server_next + s_first.len;
+
+    /* One batch: ACK the held segment (the sent callback writes again), then
+     * reset the connection, which releases everything still written */
+    const void *pkts[2] = { pkt[0], pkt[1] };
+    int lens[2];
+    lens[0] = build_tcp4(pkt[0], CLIENT_ISN + 1, acked, TCP_ACK);
+    lens[1] = build_tcp4(pkt[1], CLIENT_ISN + 1, 0, TCP_RST);
+    s_write_from_sent = 1;
+    lwip_bridge_input_batch(pkts, lens, 2);
+    CHECK(s_pcb == NULL, "connection was not reset");
+    CHECK(s_first.released == 0, "acked write released while its segment was still queued");
+
+    lwip_bridge_flush_output();
+    CHECK(s_emitted_payload == s_first.len,
+          "emitted %d payload bytes, expected %u", s_emitted_payload, s_first.len);
+    CHECK(s_first.released == 1, "acked write released %d times", s_first.released);
+    CHECK(s_second.released == 1, "write on the reset connection released %d times", s_second.released);
+
+done:
+    lwip_bridge_shutdown();
+    printf("lwip write_ref: %s\n", s_failures == 0 ? "passed" : "FAILED");
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+//
+//  vision_unpad_fuzz.c
+//  Tests
+//
+//  Randomized comparison of vision_unpad (CVLESS.c) against a C port of the
+//  Swift visionUnpadding loop it replaced, which consumed its input one
+//  segment at a time from the front of the read. Each case encodes a random
+//  stream of Vision frames (random commands, content and padding lengths,
+//  and trailing raw bytes after the last frame), cuts it into random read
+//  sizes from 1 byte to 4 KB, and feeds the same reads to both. The reader
+//  state must match after every read and the output after every stream.
+//
+//  Usage: vision_unpad_fuzz [-n streams] [-s seed]
+//
+
+#include "CVLESS.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_FRAMES  6
+#define MAX_CONTENT 3000
+#define MAX_PADDING 1500
+#define MAX_TAIL    100
+#define MAX_STREAM  (MAX_FRAMES * (5 + MAX_CONTENT + MAX_PADDING) + MAX_TAIL)
+
+/* ========================================================================
+ *  Reference: the previous Swift visionUnpadding loop
+ * ======================================================================== */
+
+/// VisionTrafficState reader fields, as the Swift loop kept them
+typedef struct {
+    int32_t remaining_command;
+    int32_t remaining_content;
+    int32_t remaining_padding;
+    int32_t current_command;
+} reference_state;
+
+/// Line-for-line port of the loop body; `pos` stands in for the front of
+/// `data`, which the Swift code advanced with removeFirst()/dropFirst()
+static size_t reference_unpad(reference_state *state,
+                              const uint8_t *data, size_t length,
+                              uint8_t *out) {
+    size_t pos = 0;
+    size_t written = 0;
+
+    while (pos < length) {
+        if (state->remaining_command > 0) {
+            uint8_t byte = data[pos++];
+            switch (state->remaining_command) {
+            case 5: state->current_command = byte; break;
+            case 4: state->remaining_content = (int32_t)byte << 8; break;
+            case 3: state->remaining_content |= (int32_t)byte; break;
+            case 2: state->remaining_padding = (int32_t)byte << 8; break;
+            case 1: state->remaining_padding |= (int32_t)byte; break;
+            default: break;
+            }
+            state->remaining_command -= 1;
+        } else if (state->remaining_content > 0) {
+            size_t to_read = (size_t)state->remaining_content;
+            if (to_read > length - pos) to_read = length - pos;
+            for (size_t i = 0; i < to_read; i++) out[written++] = data[pos + i];
+            pos += to_read;
+            state->remaining_content -= (int32_t)to_read;
+        } else if (state->remaining_padding > 0) {
+            size_t to_skip = (size_t)state->remaining_padding;
+            if (to_skip > length - pos) to_skip = length - pos;
+            pos += to_skip;
+            state->remaining_padding -= (int32_t)to_skip;
+        }
+
+        if (state->remaining_command <= 0 && state->remaining_content <= 0 &&
+            state->remaining_padding <= 0) {
+            if (state->current_command == 0) {
+                state->remaining_command = 5;
+            } else {
+                state->remaining_command = -1;
+                state->remaining_content = -1;
+                state->remaining_padding = -1;
+                while (pos < length) out[written++] = data[pos++];
+                break;
+            }
+        }
+    }
+
+    return written;
+}
+
+/* ========================================================================
+ *  Stream generation
+ * ======================================================================== */
+
+static uint64_t s_rng;
+
+/* xorshift64*, so a seed reproduces the same cases on every platform */
+static uint32_t next_random(void) {
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return (uint32_t)((s_rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t random_below(uint32_t bound) {
+    return next_random() % bound;
+}
+
+/// Encodes 1..MAX_FRAMES frames. Every frame but the last is usually
+/// Continue (0); the last is End (1) or Direct (2). Now and then a frame
+/// carries an early End/Direct or an arbitrary command byte, and the stream
+/// ends with raw bytes the reader must pass through.
+static size_t make_stream(uint8_t *stream) {
+    size_t length = 0;
+    uint32_t frames = 1 + random_below(MAX_FRAMES);
+
+    for (uint32_t f = 0; f < frames; f++) {
+        uint32_t command;
+        if (f == frames - 1) {
+            command = 1 + random_below(2);
+        } else {
+            command = random_below(8) != 0 ? 0 : random_below(3);
+        }
+        if (random_below(50) == 0) command = random_below(256);
+
+        uint32_t content = random_below(3) == 0 ? 0 : random_below(MAX_CONTENT);
+        uint32_t padding = random_below(2) == 0 ? 0 : random_below(MAX_PADDING);
+        stream[length++] = (uint8_t)command;
+        stream[length++] = (uint8_t)(content >> 8);
+        stream[length++] = (uint8_t)content;
+        stream[length++] = (uint8_t)(padding >> 8);
+        stream[length++] = (uint8_t)padding;
+        for (uint32_t i = 0; i < content + padding; i++) {
+            stream[length++] = (uint8_t)next_random();
+        }
+    }
+
+    uint32_t tail = random_below(MAX_TAIL);
+    for (uint32_t i = 0; i < tail; i++) stream[length++] = (uint8_t)next_random();
+    return length;
+}
+
+/// Read sizes: mostly up to 4 KB, with a quarter of them tiny so frame
+/// headers regularly split across reads
+static size_t next_read_size(void) {
+    return 1 + random_below(random_below(4) == 0 ? 8 : 4096);
+}
+
+/* ========================================================================
+ *  Main
+ * ======================================================================== */
+
+static int same_state(const vision_unpad_state *a, const reference_state *b) {
+    return a->remaining_command == b->remaining_command &&
+           a->remaining_content == b->remaining_content &&
+           a->remaining_padding == b->remaining_padding &&
+           a->current_command == b->current_command;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-n streams] [-s seed]\n"
+            "  -n  random frame streams to compare (default 20000)\n"
+            "  -s  generator seed (default 1)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    long streams = 20000;
+    unsigned long long seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+        case 'n': streams = atol(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (streams < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    s_rng = seed ? seed : 1;
+
+    static uint8_t stream[MAX_STREAM];
+    static uint8_t out_new[MAX_STREAM], out_ref[MAX_STREAM];
+    long long total_bytes = 0, total_reads = 0;
+
+    for (long n = 0; n < streams; n++) {
+        size_t length = make_stream(stream);
+
+        /* The UUID prefix has been consumed: the first frame header is next */
+        vision_unpad_state state = { 5, -1, -1, 0 };
+        reference_state ref = { 5, -1, -1, 0 };
+        size_t pos = 0, written_new = 0, written_ref = 0;
+
+        while (pos < length) {
+            size_t read = next_read_size();
+            if (read > length - pos) read = length - pos;
+
+            if (ref.remaining_command == -1 && ref.remaining_content == -1 &&
+                ref.remaining_padding == -1) {
+                /* Past End/Direct visionUnpadding returns reads untouched
+                 * (no UUID prefix follows), before either loop runs */
+                memcpy(out_new + written_new, stream + pos, read);
+                memcpy(out_ref + written_ref, stream + pos, read);
+                written_new += read;
+                written_ref += read;
+            } else {
+                written_new += vision_unpad(&state, stream + pos, read, out_new + written_new);
+                written_ref += reference_unpad(&ref, stream + pos, read, out_ref + written_ref);
+            }
+            pos += read;
+            total_reads++;
+
+            if (!same_state(&state, &ref)) {
+                printf("FAIL stream %ld: state after %zu/%zu bytes\n"
+                       "  got      command %d content %d padding %d current %d\n"
+                       "  expected command %d content %d padding %d current %d\n",
+                       n, pos, length,
+                       state.remaining_command, state.remaining_content,
+                       state.remaining_padding, state.current_command,
+                       ref.remaining_command, ref.remaining_content,
+                       ref.remaining_padding, ref.current_command);
+                return 1;
+            }
+        }
+
+        if (written_new != written_ref || memcmp(out_new, out_ref, written_ref) != 0) {
+            printf("FAIL stream %ld: output (%zu bytes, expected %zu)\n",
+                   n, written_new, written_ref);
+            return 1;
+        }
+        total_bytes += (long long)length;
+    }
+
+    printf("vision_unpad fuzz: %ld streams, %lld reads, %lld bytes matched (seed %llu)\n",
+           streams, total_reads, total_bytes, seed);
+    return 0;
+}